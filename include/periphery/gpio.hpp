@@ -6,18 +6,44 @@
  * \license         MIT
  *
  * <a href="GitHub"> https://github.com/mpb27/cpp-periphery </a>
+ *
+ * Notes:
+ *   1) Lines are requested through the GPIO character device v2 uAPI (Linux 5.10+).
+ *   2) Event reads are zero-copy, Event has the layout of struct gpio_v2_line_event so
+ *      a single read() fills the caller's array directly.
  */
 
 #ifndef PERIPHERY_GPIO_HPP
 #define PERIPHERY_GPIO_HPP
 
 // C++11 includes:
+#include <array>
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <string>
+#include <vector>
 
 namespace periphery {
 
+    // ... per line state of the userspace debounce, used when the kernel cannot debounce a line ...
+    struct GpioDebounceLine {
+        unsigned int offset;
+        uint32_t     period_us;             // ... 0 when the line is not debounced ...
+        bool         rising;                // ... edges requested ...
+        bool         falling;
+        int          level;                 // ... settled level, -1 when unknown ...
+        bool         pending;               // ... edges seen, waiting for the line to be quiet ...
+        uint64_t     pending_ns;            // ... last edge of the burst ...
+        uint32_t     pending_seqno;
+        uint32_t     pending_line_seqno;
+        bool         ready;                 // ... settled on a new level, not delivered yet ...
+        uint64_t     ready_ns;
+        uint32_t     ready_seqno;
+        uint32_t     ready_line_seqno;
+    };
+
     class GpioChip {
     public:
         explicit GpioChip(const std::string &path);
@@ -25,24 +51,44 @@ namespace periphery {
 
     private:
         int m_fd;
+        unsigned int m_lines;
         friend class GpioPin;
+        friend class GpioLines;
     };
 
     class GpioPin {
     public:
-        enum class Direction { In, Out, Low, High };
-        enum class Edge      { None, Rising, Falling, Both };
-        enum class Bias      { Default, PullUp, PullDown, Disable };
-        enum class Drive     { Default, OpenDrain, OpenSource };
-        enum class Invert    { Off, On };
-        enum class State     { Low, High };
+        // ... Direction::Low / High are outputs with a physical initial level, Invert does not apply
+        //     to it (High with Invert::On drives the pin high and get() reads Low). The same holds
+        //     for GpioLines and GpioMmioPin ...
+        enum class Direction  { In, Out, Low, High };
+        enum class Edge       { None, Rising, Falling, Both };
+        enum class Bias       { Default, PullUp, PullDown, Disable };
+        enum class Drive      { Default, OpenDrain, OpenSource };
+        enum class Invert     { Off, On };
+        enum class State      { Low, High };
+        enum class EventClock { Monotonic, Realtime };
+
+        struct Event {
+            uint64_t timestamp_ns;  // ... kernel timestamp, clock selected by EventClock ...
+            uint32_t id;            // ... 1 = rising edge, 2 = falling edge ...
+            uint32_t offset;        // ... line offset on the chip ...
+            uint32_t seqno;         // ... sequence number across all lines of the request ...
+            uint32_t line_seqno;    // ... sequence number on this line ...
+            uint32_t reserved[6];
+
+            auto edge() const -> Edge { return id == 1 ? Edge::Rising : Edge::Falling; }
+        };
 
         GpioPin(std::shared_ptr<GpioChip> chip, unsigned int line, const std::string& label,
                 Direction direction,
                 Edge edge = GpioPin::Edge::None,
                 Bias bias = GpioPin::Bias::Default,
                 Drive drive = GpioPin::Drive::Default,
-                Invert invert = GpioPin::Invert::Off);
+                Invert invert = GpioPin::Invert::Off,
+                EventClock clock = GpioPin::EventClock::Monotonic,
+                unsigned int event_buffer_size = 0,
+                std::chrono::microseconds debounce = std::chrono::microseconds(0));
         //GpioPin(const GpioPin&) = delete;
         //GpioPin& operator=(const GpioPin&) = delete;
         ~GpioPin();
@@ -51,8 +97,31 @@ namespace periphery {
         auto get() const -> State;
         void set(State value);
 
+        // ... edge events, read_events() blocks until at least one event is queued and then
+        //     drains as many as fit into events in a single read(). With the userspace debounce
+        //     wait_events() also returns true for held edges, the next read_events() returns 0 when
+        //     they settle back to the previous level, so a wait / read loop just waits again ...
+        auto read_events(Event* events, std::size_t count) -> std::size_t;
+        template <std::size_t N>
+        auto read_events(std::array<Event, N>& events) -> std::size_t { return read_events(events.data(), N); }
+        auto wait_events(std::chrono::milliseconds timeout) const -> bool;
+        auto dropped_events() const -> uint64_t { return m_dropped; }
+
+        // ... reconfiguration keeps the line requested and costs one ioctl. With Direction::Out the pin
+        //     keeps its current physical level, an output's driven level and an input's sampled
+        //     level (one more ioctl), also when the inversion changes ...
         void reconfigure(GpioPin::Direction direction, GpioPin::Edge edge, GpioPin::Bias bias,
                          GpioPin::Drive drive, GpioPin::Invert invert);
+        void reconfigure(GpioPin::Direction direction, GpioPin::Edge edge, GpioPin::Bias bias,
+                         GpioPin::Drive drive, GpioPin::Invert invert, std::chrono::microseconds debounce);
+
+        // ... debounce of an input line, done by the kernel (in hardware or in the gpiolib edge detector)
+        //     when it can, otherwise in read_events(): edges are held until the line has been quiet for
+        //     the period, then the settled level is read and reported if it changed, like the kernel
+        //     does, see debounce_in_kernel() ...
+        auto debounce() const -> std::chrono::microseconds;
+        void debounce(std::chrono::microseconds value);
+        auto debounce_in_kernel() const -> bool { return !m_soft_debounce; }
 
         // ... getters ...
         auto direction() const -> GpioPin::Direction;
@@ -60,6 +129,7 @@ namespace periphery {
         auto bias()      const -> GpioPin::Bias;
         auto drive()     const -> GpioPin::Drive;
         auto invert()    const -> GpioPin::Invert;
+        auto clock()     const -> GpioPin::EventClock;
 
         // ... setters ...
         void direction(GpioPin::Direction value);
@@ -67,6 +137,7 @@ namespace periphery {
         void bias(GpioPin::Bias value);
         void drive(GpioPin::Drive value);
         void invert(GpioPin::Invert value);
+        void clock(GpioPin::EventClock value);
 
     private:
         std::shared_ptr<GpioChip> m_chip;
@@ -78,9 +149,104 @@ namespace periphery {
         Bias m_bias;
         Drive m_drive;
         Invert m_invert;
+        EventClock m_clock;
+        unsigned int m_event_buffer_size;
+        bool m_value;
+        std::chrono::microseconds m_debounce;
+        bool m_soft_debounce;
+        std::vector<GpioDebounceLine> m_debounce_lines;
+        uint32_t m_last_seqno;
+        uint64_t m_dropped;
+
+        void open(GpioPin::Direction direction, GpioPin::Edge edge, GpioPin::Bias bias, GpioPin::Drive drive,
+                  GpioPin::Invert invert, GpioPin::EventClock clock, std::chrono::microseconds debounce);
+        void apply(GpioPin::Direction direction, GpioPin::Edge edge, GpioPin::Bias bias, GpioPin::Drive drive,
+                   GpioPin::Invert invert, GpioPin::EventClock clock, std::chrono::microseconds debounce);
+    };
+
+    /*!
+     * A group of up to 64 lines of one chip held by a single GPIO v2 line request (one fd).
+     * Values are exchanged as bitmaps, bit i being the i-th line passed to the constructor,
+     * so reading or writing any subset of the lines is a single ioctl and all written lines
+     * change state together.
+     */
+    class GpioLines {
+    public:
+        static constexpr std::size_t max_lines = 64;
+
+        using Event = GpioPin::Event;
+
+        struct LineConfig {
+            LineConfig(GpioPin::Direction direction,
+                       GpioPin::Edge edge = GpioPin::Edge::None,
+                       GpioPin::Bias bias = GpioPin::Bias::Default,
+                       GpioPin::Drive drive = GpioPin::Drive::Default,
+                       GpioPin::Invert invert = GpioPin::Invert::Off,
+                       GpioPin::EventClock clock = GpioPin::EventClock::Monotonic,
+                       std::chrono::microseconds debounce = std::chrono::microseconds(0))
+                : direction(direction), edge(edge), bias(bias), drive(drive), invert(invert), clock(clock),
+                  debounce(debounce) { }
+
+            GpioPin::Direction  direction;
+            GpioPin::Edge       edge;
+            GpioPin::Bias       bias;
+            GpioPin::Drive      drive;
+            GpioPin::Invert     invert;
+            GpioPin::EventClock clock;
+            std::chrono::microseconds debounce;
+        };
+
+        // ... same configuration for every line ...
+        GpioLines(std::shared_ptr<GpioChip> chip, const std::vector<unsigned int>& lines, const std::string& label,
+                  const LineConfig& config, unsigned int event_buffer_size = 0);
+        // ... one configuration per line, configs[i] applies to lines[i] ...
+        GpioLines(std::shared_ptr<GpioChip> chip, const std::vector<unsigned int>& lines, const std::string& label,
+                  const std::vector<LineConfig>& configs, unsigned int event_buffer_size = 0);
+        ~GpioLines();
+
+        // ... disable copy-constructor and copy assignment ...
+        GpioLines(const GpioLines&) = delete;
+        GpioLines& operator=(const GpioLines&) = delete;
+
+        // ... bulk access, one ioctl each, bits outside of mask are ignored ...
+        auto get_values(uint64_t mask = ~0ULL) const -> uint64_t;
+        void set_values(uint64_t mask, uint64_t bits);
+
+        // ... edge events from any line of the request, see GpioPin::read_events() ...
+        auto read_events(Event* events, std::size_t count) -> std::size_t;
+        template <std::size_t N>
+        auto read_events(std::array<Event, N>& events) -> std::size_t { return read_events(events.data(), N); }
+        auto wait_events(std::chrono::milliseconds timeout) const -> bool;
+        auto dropped_events() const -> uint64_t { return m_dropped; }
+        auto debounce_in_kernel() const -> bool { return !m_soft_debounce; }
+
+        // ... change the configuration of held lines in place, one ioctl, lines are never released,
+        //     Direction::Out keeps the physical level as in GpioPin::reconfigure() ...
+        void reconfigure(std::size_t index, const LineConfig& config);
+        void reconfigure(const std::vector<LineConfig>& configs);
+
+        // ... getters ...
+        auto size() const -> std::size_t { return m_lines.size(); }
+        auto line(std::size_t index) const -> unsigned int { return m_lines.at(index); }
+        auto config(std::size_t index) const -> const LineConfig& { return m_configs.at(index); }
+
+    private:
+        std::shared_ptr<GpioChip> m_chip;
+        int                       m_fd;
+        uint64_t                  m_all;
+        std::vector<unsigned int> m_lines;
+        std::vector<LineConfig>   m_configs;
+        std::string               m_label;
+        uint64_t                  m_values;
+        unsigned int              m_event_buffer_size;
+        uint32_t                  m_last_seqno;
+        uint64_t                  m_dropped;
+        bool                      m_soft_debounce;
+        std::vector<GpioDebounceLine> m_debounce_lines;
 
-        void reopen(GpioPin::Direction direction, GpioPin::Edge edge, GpioPin::Bias bias, GpioPin::Drive drive, GpioPin::Invert invert);
+        void open();
+        void set_soft_debounce(bool enable);
     };
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,129 @@
+/*!
+ * \package         cpp-periphery
+ * \file            gpio_mmio.hpp
+ * \author          Mark Butowski (github.com/mpb27)
+ * \date            2020-10-13
+ * \license         MIT
+ *
+ * <a href="GitHub"> https://github.com/mpb27/cpp-periphery </a>
+ *
+ * Notes:
+ *   1) The line is still requested through the GPIO character device so the kernel knows it is
+ *      owned and configures direction, bias and drive. Only get()/set() go straight to the bank
+ *      registers, a set() is one store when the bank has set/clear registers.
+ *   2) Example layouts (offsets from the start of one bank):
+ *          i.MX6/7/8   { 0x00 (DR), 0x04 (GDIR), none, none, 32, true }
+ *          AM335x      { 0x138 (DATAIN), 0x134 (OE), 0x194 (SETDATAOUT), 0x190 (CLEARDATAOUT), 32, false }
+ *          Allwinner   { 0x10 (Pn_DAT), none, none, none, 32, true }
+ */
+
+#ifndef PERIPHERY_GPIO_MMIO_HPP
+#define PERIPHERY_GPIO_MMIO_HPP
+
+// C++11 includes:
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+
+#include "periphery/gpio.hpp"
+#include "periphery/mmio.hpp"
+
+namespace periphery {
+
+    struct GpioBankLayout {
+        static constexpr std::size_t none = std::numeric_limits<std::size_t>::max();
+
+        std::size_t  data;                 // ... level register, read for get(), read-modify-write for set() without set/clear ...
+        std::size_t  direction;            // ... direction register or none, only used to check the layout ...
+        std::size_t  set;                  // ... write-1-to-set register or none ...
+        std::size_t  clear;                // ... write-1-to-clear register or none ...
+        unsigned int width;                // ... register width in bits, 8, 16 or 32 ...
+        bool         direction_out_is_one; // ... direction bit is 1 for an output ...
+    };
+
+    class GpioMmioPin {
+    public:
+        GpioMmioPin(std::shared_ptr<GpioChip> chip, unsigned int line, const std::string& label,
+                    std::shared_ptr<Mmio> bank, const GpioBankLayout& layout, unsigned int bit,
+                    GpioPin::Direction direction,
+                    GpioPin::Bias bias = GpioPin::Bias::Default,
+                    GpioPin::Drive drive = GpioPin::Drive::Default,
+                    GpioPin::Invert invert = GpioPin::Invert::Off);
+
+        // ... disable copy-constructor and copy assignment ...
+        GpioMmioPin(const GpioMmioPin&) = delete;
+        GpioMmioPin& operator=(const GpioMmioPin&) = delete;
+
+        auto get() const -> GpioPin::State;
+        void set(GpioPin::State value);
+
+        // ... getters, Direction::Low / High mean the same as for GpioPin, see GpioPin::Direction ...
+        auto direction() const -> GpioPin::Direction { return m_pin.direction(); }
+        auto bias()      const -> GpioPin::Bias      { return m_pin.bias(); }
+        auto drive()     const -> GpioPin::Drive     { return m_pin.drive(); }
+        auto invert()    const -> GpioPin::Invert    { return m_invert; }
+
+        // ... setters, these go through the character device (one ioctl) ...
+        void direction(GpioPin::Direction value);
+        void bias(GpioPin::Bias value)   { m_pin.bias(value); }
+        void drive(GpioPin::Drive value) { m_pin.drive(value); }
+        void invert(GpioPin::Invert value) { m_invert = value; }
+
+    private:
+        GpioPin               m_pin;
+        std::shared_ptr<Mmio> m_bank;
+        GpioBankLayout        m_layout;
+        uint32_t              m_mask;
+        GpioPin::Invert       m_invert;
+        uint8_t*              m_data;
+        uint8_t*              m_set;
+        uint8_t*              m_clear;
+
+        auto load(const uint8_t* reg) const -> uint32_t;
+        void store(uint8_t* reg, uint32_t value) const;
+        void check_direction() const;
+    };
+
+
+    inline auto GpioMmioPin::load(const uint8_t* reg) const -> uint32_t
+    {
+        switch (m_layout.width) {
+            case 8:  return *reinterpret_cast<const volatile uint8_t*>(reg);
+            case 16: return *reinterpret_cast<const volatile uint16_t*>(reg);
+            default: return *reinterpret_cast<const volatile uint32_t*>(reg);
+        }
+    }
+
+    inline void GpioMmioPin::store(uint8_t* reg, uint32_t value) const
+    {
+        switch (m_layout.width) {
+            case 8:  *reinterpret_cast<volatile uint8_t*>(reg)  = static_cast<uint8_t>(value); break;
+            case 16: *reinterpret_cast<volatile uint16_t*>(reg) = static_cast<uint16_t>(value); break;
+            default: *reinterpret_cast<volatile uint32_t*>(reg) = value; break;
+        }
+    }
+
+    inline auto GpioMmioPin::get() const -> GpioPin::State
+    {
+        bool high = (load(m_data) & m_mask) != 0;
+        high ^= (m_invert == GpioPin::Invert::On);
+        return high ? GpioPin::State::High : GpioPin::State::Low;
+    }
+
+    inline void GpioMmioPin::set(GpioPin::State value)
+    {
+        bool high = (value == GpioPin::State::High) ^ (m_invert == GpioPin::Invert::On);
+        if (m_set != nullptr) {
+            // ... single store, no read-modify-write race with other lines of the bank ...
+            store(high ? m_set : m_clear, m_mask);
+        } else {
+            // ... non-atomic, other lines of the bank must not be written concurrently ...
+            uint32_t data = load(m_data);
+            store(m_data, high ? (data | m_mask) : (data & ~m_mask));
+        }
+    }
+}
+
+#endif
@@ -22,14 +22,28 @@
 #include <cstring>
 #include <functional>
 #include <initializer_list>
+#include <stdexcept>
+#include <string>
 #include <system_error>
 #include <vector>
 
+#include <periphery/buffer.hpp>
+
 namespace periphery {
 
 class I2C {
 public:
     class Message;  // ... forward define ...
+    class BufferMessage;
+    template <std::size_t N> class Transaction;
+
+    // ... kernel limit on the number of messages in one I2C_RDWR ...
+    static constexpr std::size_t max_messages = 42;
+    // ... SMBus block transfers carry at most 32 bytes ...
+    static constexpr std::size_t smbus_block_max = 32;
+
+    // ... byte order of 16 bit register values, SMBus words are little endian ...
+    enum class ByteOrder { LittleEndian, BigEndian };
 
     // ... constructor / destructor ...
     I2C(const std::string& path);
@@ -47,6 +61,45 @@ public:
 
     void transfer(uint16_t addr, std::initializer_list<std::reference_wrapper<Message>> messages) const;
 
+    // ... allocation free transfers over caller-owned buffers, the message array is handed to
+    //     the kernel as is, every message carries its own address ...
+    void transfer(const BufferMessage* messages, std::size_t count) const;
+    template <std::size_t N>
+    void transfer(const Transaction<N>& transaction) const { transfer(transaction.data(), transaction.size()); }
+    // ... same, with every message sent to addr ...
+    void transfer(uint16_t addr, std::initializer_list<BufferMessage> messages) const;
+
+    // ... SMBus transfers through I2C_SMBUS, each one ioctl plus an I2C_SLAVE when the address
+    //     differs from the previous SMBus transfer ...
+    void     smbus_quick(uint16_t addr, bool read) const;
+    uint8_t  smbus_read_byte(uint16_t addr) const;
+    void     smbus_write_byte(uint16_t addr, uint8_t value) const;
+    uint8_t  smbus_read_byte_data(uint16_t addr, uint8_t command) const;
+    void     smbus_write_byte_data(uint16_t addr, uint8_t command, uint8_t value) const;
+    uint16_t smbus_read_word_data(uint16_t addr, uint8_t command) const;
+    void     smbus_write_word_data(uint16_t addr, uint8_t command, uint16_t value) const;
+    uint16_t smbus_process_call(uint16_t addr, uint8_t command, uint16_t value) const;
+    std::size_t smbus_read_block_data(uint16_t addr, uint8_t command, mutable_buffer rx) const;
+    void     smbus_write_block_data(uint16_t addr, uint8_t command, const_buffer tx) const;
+    void     smbus_read_i2c_block_data(uint16_t addr, uint8_t command, mutable_buffer rx) const;
+    void     smbus_write_i2c_block_data(uint16_t addr, uint8_t command, const_buffer tx) const;
+
+    // ... packet error checking on SMBus transfers ...
+    void pec(bool enable);
+    bool pec() const { return m_pec; }
+
+    // ... register access with an 8 bit register address, uses a single SMBus transfer when the
+    //     adapter supports it and no address switch is needed (or PEC is on, or the adapter is
+    //     SMBus only), otherwise a combined I2C_RDWR transfer ...
+    uint8_t  read_reg8(uint16_t addr, uint8_t reg) const;
+    void     write_reg8(uint16_t addr, uint8_t reg, uint8_t value) const;
+    uint16_t read_reg16(uint16_t addr, uint8_t reg, ByteOrder order = ByteOrder::LittleEndian) const;
+    void     write_reg16(uint16_t addr, uint8_t reg, uint16_t value, ByteOrder order = ByteOrder::LittleEndian) const;
+
+    // ... adapter functionality, the I2C_FUNC_* mask from <linux/i2c.h> ...
+    unsigned long functions() const { return m_funcs; }
+    bool supports(unsigned long funcs) const { return (m_funcs & funcs) == funcs; }
+
     // ... extra ...
     std::string toString() const;
 
@@ -64,9 +117,82 @@ public:
         Message() { };
         friend class I2C;
     };
+
+    /*!
+     * A message over a caller-owned buffer, the buffer must stay valid until the transfer returns.
+     * The layout matches struct i2c_msg, so arrays of BufferMessage go straight to I2C_RDWR.
+     */
+    class BufferMessage {
+    public:
+        BufferMessage() : m_addr(0), m_flags(0), m_len(0), m_buf(nullptr) { }
+
+        static BufferMessage write(const_buffer tx)                { return BufferMessage(0, 0, tx.size(), tx.data()); }
+        static BufferMessage write(uint16_t addr, const_buffer tx) { return BufferMessage(addr, 0, tx.size(), tx.data()); }
+        static BufferMessage read(mutable_buffer rx)                { return BufferMessage(0, flag_read, rx.size(), rx.data()); }
+        static BufferMessage read(uint16_t addr, mutable_buffer rx) { return BufferMessage(addr, flag_read, rx.size(), rx.data()); }
+
+        uint16_t address() const { return m_addr; }
+        bool     is_read() const { return (m_flags & flag_read) != 0; }
+        std::size_t size() const { return m_len; }
+        void*    data()    const { return m_buf; }
+
+    private:
+        static constexpr uint16_t flag_read = 0x0001;  // ... I2C_M_RD ...
+
+        BufferMessage(uint16_t addr, uint16_t flags, std::size_t len, const void* buf)
+            : m_addr(addr), m_flags(flags), m_len(static_cast<uint16_t>(len)),
+              m_buf(static_cast<uint8_t*>(const_cast<void*>(buf)))
+        {
+            if (len > 0xFFFF) {
+                throw std::invalid_argument("I2C message longer than 65535 bytes");
+            }
+        }
+
+        uint16_t m_addr;
+        uint16_t m_flags;
+        uint16_t m_len;
+        uint8_t* m_buf;
+        friend class I2C;
+    };
+
+    /*!
+     * Up to N (at most 42) messages built in place, usually on the stack, and sent with a single
+     * I2C_RDWR. Nothing is allocated, clear() and rebuild it to reuse it for the next cycle.
+     */
+    template <std::size_t N>
+    class Transaction {
+        static_assert(N > 0 && N <= max_messages, "I2C transaction must hold 1 to 42 messages.");
+    public:
+        Transaction() : m_count(0) { }
+
+        Transaction& write(uint16_t addr, const_buffer tx)  { return add(BufferMessage::write(addr, tx)); }
+        Transaction& read(uint16_t addr, mutable_buffer rx) { return add(BufferMessage::read(addr, rx)); }
+        Transaction& add(const BufferMessage& message)
+        {
+            if (m_count == N) {
+                throw std::length_error("I2C transaction is full");
+            }
+            m_messages[m_count++] = message;
+            return *this;
+        }
+
+        void clear() { m_count = 0; }
+        std::size_t size() const { return m_count; }
+        const BufferMessage* data() const { return m_messages.data(); }
+
+    private:
+        std::array<BufferMessage, N> m_messages;
+        std::size_t                  m_count;
+    };
 private:
     int m_fd;
     std::string m_path;
+    unsigned long m_funcs;
+    bool m_pec;
+    mutable int m_selected;   // ... address set with I2C_SLAVE, -1 if none ...
+
+    void select(uint16_t addr) const;
+    bool use_smbus(uint16_t addr, unsigned long func) const;
     template <typename ForwardIt>
     void transfer_impl(uint16_t addr, ForwardIt first, ForwardIt last) const;
     void transfer(uint16_t addr, std::vector<std::reference_wrapper<Message>>& messages) const;
@@ -0,0 +1,77 @@
+/*
+ * cpp-periphery
+ * https://github.com/mpb27/cpp-periphery
+ * License: MIT
+ *
+ * Notes:
+ *   1) Register cache for devices with 8 bit register addresses and 8 bit registers, similar
+ *      to a Linux regmap with REGCACHE_FLAT.
+ *   2) sync() writes every run of contiguous dirty registers as one burst (register address
+ *      followed by the values), so the device must auto-increment its register address on
+ *      writes. All bursts go out in one I2C_RDWR (or one per 42 bursts).
+ */
+
+#ifndef PERIPHERY_I2C_REGCACHE_HPP
+#define PERIPHERY_I2C_REGCACHE_HPP
+
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <vector>
+
+#include "periphery/i2c.hpp"
+
+namespace periphery {
+
+class I2CRegisterCache {
+public:
+    enum class Mode { WriteThrough, WriteBack };
+
+    I2CRegisterCache(std::shared_ptr<I2C> i2c, uint16_t addr, std::size_t num_registers, Mode mode,
+                     std::initializer_list<uint8_t> volatile_registers = {}, std::size_t max_burst = 32);
+
+    // ... disable copy-constructor and copy assignment ...
+    I2CRegisterCache(const I2CRegisterCache&) = delete;
+    I2CRegisterCache& operator=(const I2CRegisterCache&) = delete;
+
+    // ... reads of cached registers never touch the bus, volatile registers always do ...
+    uint8_t read(uint8_t reg);
+    // ... write-back defers the write until sync(), write-through and volatile registers write now ...
+    void    write(uint8_t reg, uint8_t value);
+    // ... read-modify-write on the cached value, nothing is written when the value does not change ...
+    void    update_bits(uint8_t reg, uint8_t mask, uint8_t value);
+
+    // ... write all dirty registers, contiguous ones merged into bursts ...
+    void    sync();
+    // ... read count registers starting at first into the cache with one burst read ...
+    void    fill(uint8_t first, std::size_t count);
+    // ... forget all cached values and pending writes, e.g. after the device was reset ...
+    void    invalidate();
+
+    bool    dirty() const { return m_dirty.any(); }
+    Mode    mode() const { return m_mode; }
+    // ... switching to write-through flushes pending writes ...
+    void    mode(Mode mode);
+
+private:
+    std::shared_ptr<I2C>  m_i2c;
+    uint16_t              m_addr;
+    std::size_t           m_size;
+    Mode                  m_mode;
+    std::size_t           m_max_burst;
+    std::array<uint8_t, 256> m_values;
+    std::bitset<256>      m_valid;
+    std::bitset<256>      m_dirty;
+    std::bitset<256>      m_volatile;
+    std::vector<uint8_t>  m_tx;     // ... staging for burst writes, allocated once ...
+
+    void check(uint8_t reg) const;
+    void write_now(uint8_t reg, uint8_t value);
+};
+
+} // ... namespace periphery ...
+
+#endif // PERIPHERY_I2C_REGCACHE_HPP
@@ -0,0 +1,121 @@
+/*
+ * cpp-periphery
+ * https://github.com/mpb27/cpp-periphery
+ * License: MIT
+ *
+ * Notes:
+ *   1) One worker thread owns the bus. Queued transactions, for any address, are packed into a
+ *      single I2C_RDWR up to the kernel limit of 42 messages, highest priority first and in
+ *      submission order within a priority.
+ *   2) Packed transactions are joined with repeated starts instead of stops. The kernel reports a
+ *      failed I2C_RDWR as a whole, so an error (e.g. a NAK) fails every transaction of that
+ *      batch. Submit with batchable = false for devices that need a stop or are expected to NAK.
+ *   3) Message buffers are caller-owned and must stay valid until the transaction completes.
+ */
+
+#ifndef PERIPHERY_I2C_SCHEDULER_HPP
+#define PERIPHERY_I2C_SCHEDULER_HPP
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "periphery/i2c.hpp"
+
+namespace periphery {
+
+class I2CScheduler {
+public:
+    enum class Priority { High = 0, Normal = 1, Low = 2 };
+    static constexpr std::size_t num_priorities = 3;
+
+    using Callback = std::function<void(std::error_code)>;
+
+    // ... queue latency is submit to start of the ioctl, total latency is submit to completion ...
+    struct LatencyStats {
+        uint64_t                 count;
+        std::chrono::nanoseconds queue_mean;
+        std::chrono::nanoseconds queue_max;
+        std::chrono::nanoseconds total_mean;
+        std::chrono::nanoseconds total_max;
+    };
+
+    explicit I2CScheduler(std::shared_ptr<I2C> i2c);
+    // ... pending transactions are failed with operation_canceled ...
+    ~I2CScheduler();
+
+    // ... disable copy-constructor and copy assignment ...
+    I2CScheduler(const I2CScheduler&) = delete;
+    I2CScheduler& operator=(const I2CScheduler&) = delete;
+
+    // ... completion through a future (std::system_error on failure) ...
+    std::future<void> submit(Priority priority, const I2C::BufferMessage* messages, std::size_t count,
+                             bool batchable = true);
+    template <std::size_t N>
+    std::future<void> submit(Priority priority, const I2C::Transaction<N>& transaction, bool batchable = true)
+    {
+        return submit(priority, transaction.data(), transaction.size(), batchable);
+    }
+
+    // ... completion through a callback, called on the worker thread, keep it short ...
+    void submit(Priority priority, const I2C::BufferMessage* messages, std::size_t count, Callback callback,
+                bool batchable = true);
+    template <std::size_t N>
+    void submit(Priority priority, const I2C::Transaction<N>& transaction, Callback callback, bool batchable = true)
+    {
+        submit(priority, transaction.data(), transaction.size(), std::move(callback), batchable);
+    }
+
+    LatencyStats latency(Priority priority) const;
+    void reset_latency();
+
+    // ... number of I2C_RDWR ioctls and transactions so far, transactions / batches is the packing ratio ...
+    uint64_t batches() const;
+    uint64_t transactions() const;
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    struct Job {
+        std::vector<I2C::BufferMessage> messages;
+        bool                            batchable;
+        clock::time_point               submitted;
+        Callback                        callback;
+    };
+
+    struct Stats {
+        uint64_t                 count;
+        std::chrono::nanoseconds queue_total;
+        std::chrono::nanoseconds queue_max;
+        std::chrono::nanoseconds total_total;
+        std::chrono::nanoseconds total_max;
+    };
+
+    std::shared_ptr<I2C>                    m_i2c;
+    mutable std::mutex                      m_mutex;
+    std::condition_variable                 m_cv;
+    std::array<std::deque<Job>, num_priorities> m_queues;
+    std::array<Stats, num_priorities>       m_stats;
+    uint64_t                                m_batches;
+    uint64_t                                m_transactions;
+    bool                                    m_stop;
+    std::thread                             m_thread;
+
+    void enqueue(Priority priority, const I2C::BufferMessage* messages, std::size_t count, Callback callback,
+                 bool batchable);
+    void run();
+};
+
+} // ... namespace periphery ...
+
+#endif // PERIPHERY_I2C_SCHEDULER_HPP
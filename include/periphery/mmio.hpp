@@ -13,57 +13,189 @@
  *          https://stackoverflow.com/questions/45972/mmap-vs-reading-blocks
  *   4) Include headers:
  *          https://stackoverflow.com/a/2029106/953414
+ *   5) The single register accessors are inline and always bounds checked (std::invalid_argument),
+ *      a compare and a predictable branch in front of the volatile access. The unchecked fast
+ *      paths are view(), validated once and then indexed with a check only when NDEBUG is not
+ *      defined, and MmioBlock (mmio_register.hpp), checked at compile time.
+ *   6) read() / write() of bytes use memcpy, the access width is up to the C library. The burst
+ *      and fifo functions access the device with exactly the named width, offset and count are
+ *      always validated. non_temporal moves 16 bytes per access with streaming loads / stores
+ *      (x86 SSE4.1 MOVNTDQA / SSE2 MOVNTDQ), meant for write-combined memory such as prefetchable
+ *      PCI BARs, never for registers. Elsewhere it falls back to the plain width.
+ *   7) Mappings are shared process wide. An Mmio whose pages are covered by a live mapping of
+ *      the same source reuses it, a partially overlapping range gets a new mapping of the union
+ *      that later Mmio share. Mappings are unmapped with their last Mmio.
+ *   8) /dev/mem (and the remap_pfn_range based UIO / PCI) mappings get their page tables filled
+ *      at mmap time and are not pageable, populate and lock matter for RAM backed sources.
+ *      huge_pages only aligns the virtual address to the huge page size (the file range stays page
+ *      granular) and asks for transparent huge pages. Only RAM backed sources (memfd, files on
+ *      tmpfs) can get them, pfn mapped sources (/dev/mem, UIO, PCI resource files) always stay
+ *      on small pages, the option is harmless there.
+ *   9) Sources other than /dev/mem, see the *_region() helpers:
+ *          UIO maps         /dev/uioN, map M at offset M * page size, sizes from sysfs
+ *          PCI BARs         /sys/bus/pci/devices/<address>/resourceN[_wc], size from the file
+ *          files / memfds   any mappable file, an fd is reopened through /proc/self/fd
+ *      Mappings are shared per path, an fd region needs the fd open as long as the Mmio lives.
+ *  10) set*() / clear*() are plain read-modify-write. modify*() takes one of 64 spin locks picked
+ *      by (path, offset of the register in the source), so it serializes against modify*() of
+ *      the same register through any Mmio in the process and works on device memory.
+ *      atomic_modify32() is a lock free CAS loop, only for cacheable RAM backed mappings (memfd,
+ *      files, shared RAM); exclusive / locked accesses to device memory fault or are undefined.
  */
 
 #ifndef PERIPHERY_MMIO_HPP
 #define PERIPHERY_MMIO_HPP
 
 // C++11 includes:
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
 
 namespace periphery {
 
+struct MmioMapping;
+
 class Mmio {
 public:
+    struct MapOptions {
+        bool populate;      // ... MAP_POPULATE, prefault at map time ...
+        bool lock;          // ... mlock, throws std::system_error when RLIMIT_MEMLOCK is too low ...
+        bool huge_pages;    // ... huge page aligned, MADV_HUGEPAGE ...
+    };
+
+    // ... what to map, size bytes at offset inside the mmap window at base of path ...
+    struct Region {
+        std::string path;
+        uint64_t    base;
+        uint64_t    offset;
+        size_t      size;
+        bool        from_start;     // ... the window can only be mapped from its first page (UIO) ...
+    };
+
+    static Region dev_mem_region(uintptr_t base, size_t size);
+    static Region uio_region(unsigned device, unsigned map);
+    static Region pci_region(const std::string& address, unsigned bar, bool write_combined = false);
+    static Region file_region(const std::string& path, uint64_t offset, size_t size);
+    static Region fd_region(int fd, uint64_t offset, size_t size);
+
     // ... constructor / destructor ...
-    Mmio(uintptr_t base, size_t size);
+    Mmio(uintptr_t base, size_t size, MapOptions options = MapOptions{ false, false, false });
+    explicit Mmio(const Region& region, MapOptions options = MapOptions{ false, false, false });
     ~Mmio();
     // ... disable copy-constructor and copy assignment ...
     Mmio(const Mmio&) = delete;
     Mmio& operator=(const Mmio&) = delete;
 
+    // ... volatile array over part of the mapping, valid as long as the Mmio ...
+    template <typename T>
+    class View {
+    public:
+        View(volatile T* data, size_t count) : m_data(data), m_count(count) { }
+        volatile T& operator[](size_t index) const
+        {
+#ifndef NDEBUG
+            if (index >= m_count) {
+                throw std::out_of_range("view index out of range");
+            }
+#endif
+            return m_data[index];
+        }
+        volatile T* data() const  { return m_data; }
+        volatile T* begin() const { return m_data; }
+        volatile T* end() const   { return m_data + m_count; }
+        size_t size() const { return m_count; }
+    private:
+        volatile T* m_data;
+        size_t      m_count;
+    };
+
     // ... reads ...
-    uint32_t read32(size_t offset) const;
-    uint16_t read16(size_t offset) const;
-    uint8_t  read8 (size_t offset) const;
+    uint32_t read32(size_t offset) const { return read<uint32_t>(offset); }
+    uint16_t read16(size_t offset) const { return read<uint16_t>(offset); }
+    uint8_t  read8 (size_t offset) const { return read<uint8_t >(offset); }
     void     read(size_t offset, uint8_t* buf, size_t len) const;
     // ... writes ...
-    void     write32(size_t offset, uint32_t value) const;
-    void     write16(size_t offset, uint16_t value) const;
-    void     write8(size_t offset, uint8_t value) const;
+    void     write32(size_t offset, uint32_t value) const { write<uint32_t>(offset, value); }
+    void     write16(size_t offset, uint16_t value) const { write<uint16_t>(offset, value); }
+    void     write8 (size_t offset, uint8_t value)  const { write<uint8_t >(offset, value); }
     void     write(size_t offset, const uint8_t* buf, size_t len) const;
+    // ... bursts, incrementing address, exact access width ...
+    void     read_burst32 (size_t offset, uint32_t* buf, size_t count, bool non_temporal = false) const;
+    void     read_burst64 (size_t offset, uint64_t* buf, size_t count, bool non_temporal = false) const;
+    void     write_burst32(size_t offset, const uint32_t* buf, size_t count, bool non_temporal = false) const;
+    void     write_burst64(size_t offset, const uint64_t* buf, size_t count, bool non_temporal = false) const;
+    // ... fifos, count accesses to the same address ...
+    void     read_fifo32 (size_t offset, uint32_t* buf, size_t count) const;
+    void     read_fifo64 (size_t offset, uint64_t* buf, size_t count) const;
+    void     write_fifo32(size_t offset, const uint32_t* buf, size_t count) const;
+    void     write_fifo64(size_t offset, const uint64_t* buf, size_t count) const;
+    // ... thread safe read-modify-write, (value & ~clear) | set, returns the previous value ...
+    uint32_t modify32(size_t offset, uint32_t clear, uint32_t set) const;
+    uint16_t modify16(size_t offset, uint16_t clear, uint16_t set) const;
+    uint8_t  modify8 (size_t offset, uint8_t  clear, uint8_t  set) const;
+    uint32_t atomic_modify32(size_t offset, uint32_t clear, uint32_t set) const;
+    // ... busy waits until (read32(offset) & mask) == value, false on timeout ...
+    bool     wait32(size_t offset, uint32_t mask, uint32_t value, std::chrono::nanoseconds timeout) const;
     // ... clear and set (non-atomic) ...
-    void     clear32(size_t offset, uint32_t mask) const;
-    void     clear16(size_t offset, uint16_t mask) const;
-    void     clear8 (size_t offset, uint8_t  mask) const;
-    void     set32(size_t offset, uint32_t mask) const;
-    void     set16(size_t offset, uint16_t mask) const;
-    void     set8 (size_t offset, uint8_t  mask) const;
+    void     clear32(size_t offset, uint32_t mask) const { write32(offset, read32(offset) & ~mask); }
+    void     clear16(size_t offset, uint16_t mask) const { write16(offset, static_cast<uint16_t>(read16(offset) & ~mask)); }
+    void     clear8 (size_t offset, uint8_t  mask) const { write8 (offset, static_cast<uint8_t >(read8 (offset) & ~mask)); }
+    void     set32(size_t offset, uint32_t mask) const { write32(offset, read32(offset) | mask); }
+    void     set16(size_t offset, uint16_t mask) const { write16(offset, static_cast<uint16_t>(read16(offset) | mask)); }
+    void     set8 (size_t offset, uint8_t  mask) const { write8 (offset, static_cast<uint8_t >(read8 (offset) | mask)); }
+
+    // ... typed single access, always bounds checked ...
+    template <typename T> T read(size_t offset) const
+    {
+        static_assert(std::is_integral<T>::value && std::is_unsigned<T>::value, "Mmio access must be an unsigned integer.");
+        check(offset, sizeof(T));
+        return *reinterpret_cast<volatile T*>(m_data + offset);
+    }
+    template <typename T> void write(size_t offset, T value) const
+    {
+        static_assert(std::is_integral<T>::value && std::is_unsigned<T>::value, "Mmio access must be an unsigned integer.");
+        check(offset, sizeof(T));
+        *reinterpret_cast<volatile T*>(m_data + offset) = value;
+    }
+
+    // ... count registers of type T at offset, throws std::invalid_argument when out of bounds or misaligned ...
+    template <typename T> View<T> view(size_t offset, size_t count) const
+    {
+        static_assert(std::is_integral<T>::value && std::is_unsigned<T>::value, "Mmio access must be an unsigned integer.");
+        if (offset > m_size || count > (m_size - offset) / sizeof(T)) {
+            throw std::invalid_argument("view out of bounds");
+        }
+        if (reinterpret_cast<uintptr_t>(m_data + offset) % sizeof(T) != 0) {
+            throw std::invalid_argument("view not aligned");
+        }
+        return View<T>(reinterpret_cast<volatile T*>(m_data + offset), count);
+    }
 
     // ... pointer, should not be used after Mmio is destroyed, ensure using? ...
-    void* ptr() const { return static_cast<void*>(m_ptr + (m_base - m_aligned_base)); }
+    void* ptr() const { return static_cast<void*>(m_data); }
+    // ... size of the mapped range starting at ptr() ...
+    size_t size() const { return m_size; }
+
+    // ... number of distinct mappings alive in the process ...
+    static size_t mappings();
 
 private:
-    uintptr_t m_base;
-    uintptr_t m_aligned_base;
-    size_t    m_size;
-    size_t    m_aligned_size;
-    uint8_t*  m_ptr;
-    // ... read/write templates, private for now, but could be made public
-    //     with some static_asserts to make sure it is being used properly ...
-    template<typename T> T    read (size_t offset) const;
-    template<typename T> void write(size_t offset, T value) const;
+    size_t       m_size;
+    MmioMapping* m_mapping;
+    uint8_t*     m_data;        // ... base inside the shared mapping ...
+    uint64_t     m_lock_key;    // ... identifies offset 0 in the source, for the modify locks ...
+
+    void check(size_t offset, size_t len) const
+    {
+        if (offset > m_size || len > m_size - offset) {
+            throw std::invalid_argument("offset out of bounds");
+        }
+    }
+    // ... count accesses of width bytes from offset, always checked, for the block operations ...
+    uint8_t* range(size_t offset, size_t count, size_t width) const;
 };
 
 
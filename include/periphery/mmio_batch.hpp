@@ -0,0 +1,83 @@
+/*
+ * cpp-periphery
+ * https://github.com/mpb27/cpp-periphery
+ * License: MIT
+ *
+ * Notes:
+ *   1) Records a register programming sequence once and applies it to any Mmio, at any offset,
+ *      as often as needed (several instances of the same IP). Alignment is checked when an
+ *      operation is recorded, bounds once per apply(), the replay loop itself is only the loads
+ *      and stores.
+ *   2) Masked operations (modify / set / clear) on a register are merged with the earlier masked
+ *      operation on the same register since the last barrier(), as long as nothing overlapping it
+ *      was recorded in between. Plain writes are never merged, every one reaches the device.
+ *      A merge that covers every bit becomes a plain store, no read. The merged
+ *      operation keeps the position of the first one, so put a barrier() wherever the order of
+ *      two registers matters (enable bits last, ...).
+ *   3) barrier() is a full memory barrier for device memory (x86 MFENCE, ARM DMB OSH),
+ *      read_back() adds a load that forces posted writes (PCI) out before continuing.
+ */
+
+#ifndef PERIPHERY_MMIO_BATCH_HPP
+#define PERIPHERY_MMIO_BATCH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "periphery/mmio.hpp"
+
+namespace periphery {
+
+class MmioBatch {
+public:
+    // ... plain stores ...
+    MmioBatch& write8 (size_t offset, uint8_t  value) { return record(Kind::Write, offset, 1, ~0ull, value); }
+    MmioBatch& write16(size_t offset, uint16_t value) { return record(Kind::Write, offset, 2, ~0ull, value); }
+    MmioBatch& write32(size_t offset, uint32_t value) { return record(Kind::Write, offset, 4, ~0ull, value); }
+    MmioBatch& write64(size_t offset, uint64_t value) { return record(Kind::Write, offset, 8, ~0ull, value); }
+
+    // ... (value & ~clear) | set, same as Mmio::modify*() but without locking ...
+    MmioBatch& modify8 (size_t offset, uint8_t  clear, uint8_t  set) { return record(Kind::Modify, offset, 1, clear | set, set); }
+    MmioBatch& modify16(size_t offset, uint16_t clear, uint16_t set) { return record(Kind::Modify, offset, 2, clear | set, set); }
+    MmioBatch& modify32(size_t offset, uint32_t clear, uint32_t set) { return record(Kind::Modify, offset, 4, clear | set, set); }
+    MmioBatch& modify64(size_t offset, uint64_t clear, uint64_t set) { return record(Kind::Modify, offset, 8, clear | set, set); }
+    MmioBatch& set32  (size_t offset, uint32_t mask) { return modify32(offset, 0, mask); }
+    MmioBatch& clear32(size_t offset, uint32_t mask) { return modify32(offset, mask, 0); }
+
+    // ... ordering ...
+    MmioBatch& barrier();
+    MmioBatch& read_back(size_t offset) { return record(Kind::Read, offset, 4, 0, 0); }
+
+    // ... operations after merging, and as recorded ...
+    size_t size() const { return m_ops.size(); }
+    size_t recorded() const { return m_recorded; }
+    // ... bytes of the mapping the batch touches, from offset 0 ...
+    size_t extent() const { return m_extent; }
+    void   clear();
+
+    // ... throws std::invalid_argument when the batch does not fit at offset of mmio ...
+    void apply(const Mmio& mmio, size_t offset = 0) const;
+
+private:
+    enum class Kind : uint8_t { Write, Modify, Read, Barrier };
+
+    struct Op {
+        size_t   offset;
+        uint64_t mask;      // ... bits written, all ones for a plain store ...
+        uint64_t value;
+        uint8_t  width;
+        Kind     kind;
+    };
+
+    std::vector<Op> m_ops;
+    size_t          m_recorded = 0;
+    size_t          m_extent = 0;
+    size_t          m_align = 1;
+
+    MmioBatch& record(Kind kind, size_t offset, uint8_t width, uint64_t mask, uint64_t value);
+};
+
+} // ... namespace periphery ...
+
+#endif // PERIPHERY_MMIO_BATCH_HPP
@@ -0,0 +1,214 @@
+/*
+ * cpp-periphery
+ * https://github.com/mpb27/cpp-periphery
+ * License: MIT
+ *
+ * Notes:
+ *   1) Typed register maps over an Mmio mapping. Registers and fields are types, offsets,
+ *      widths, alignment, access rights and block bounds are all checked by static_assert,
+ *      every access compiles to a single volatile load and / or store.
+ *   2) The only runtime check is done once, when an MmioBlock is bound to a mapping.
+ *   3) Example:
+ *          struct Uart {
+ *              using DR   = MmioRegister<0x00, uint32_t>;
+ *              using FR   = MmioRegister<0x18, uint32_t, MmioAccess::ReadOnly>;
+ *              using CR   = MmioRegister<0x30, uint32_t>;
+ *              using TXFF = MmioField<FR, 5, 1>;
+ *              using EN   = MmioField<CR, 0, 1>;
+ *              using TXE  = MmioField<CR, 8, 1>;
+ *          };
+ *          MmioBlock<0x1000> uart(mmio);
+ *          uart.write(Uart::EN::of(1), Uart::TXE::of(1));     // ... one store ...
+ *          while (uart.get<Uart::TXFF>()) { }
+ *          uart.write<Uart::DR>('A');
+ */
+
+#ifndef PERIPHERY_MMIO_REGISTER_HPP
+#define PERIPHERY_MMIO_REGISTER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+
+#include "periphery/mmio.hpp"
+
+namespace periphery {
+
+enum class MmioAccess { ReadOnly, WriteOnly, ReadWrite };
+enum class MmioEndian { Native, Little, Big };
+
+namespace detail {
+
+    inline uint8_t  byteswap(uint8_t v)  { return v; }
+    inline uint16_t byteswap(uint16_t v) { return __builtin_bswap16(v); }
+    inline uint32_t byteswap(uint32_t v) { return __builtin_bswap32(v); }
+    inline uint64_t byteswap(uint64_t v) { return __builtin_bswap64(v); }
+
+    constexpr bool needs_swap(MmioEndian endian)
+    {
+        return endian == MmioEndian::Native ? false
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+             : endian == MmioEndian::Little;
+#else
+             : endian == MmioEndian::Big;
+#endif
+    }
+
+    template <typename T>
+    constexpr T low_bits(unsigned width)
+    {
+        return width >= static_cast<unsigned>(std::numeric_limits<T>::digits)
+             ? std::numeric_limits<T>::max()
+             : static_cast<T>((static_cast<uint64_t>(1) << width) - 1);
+    }
+
+    // ... or-ing of field values / masks for multi field writes ...
+    template <typename T>
+    constexpr T fold_bits() { return 0; }
+    template <typename T, typename V, typename... Vs>
+    constexpr T fold_bits(V v, Vs... vs) { return static_cast<T>(v.bits | fold_bits<T>(vs...)); }
+
+    template <typename T>
+    constexpr T fold_mask() { return 0; }
+    template <typename T, typename V, typename... Vs>
+    constexpr T fold_mask() { return static_cast<T>(V::field::mask | fold_mask<T, Vs...>()); }
+
+    template <typename R, typename... Vs>
+    struct same_register : std::true_type { };
+    template <typename R, typename V, typename... Vs>
+    struct same_register<R, V, Vs...>
+        : std::integral_constant<bool, std::is_same<R, typename V::register_type>::value
+                                       && same_register<R, Vs...>::value> { };
+
+} // ... namespace detail ...
+
+
+template <std::size_t Offset, typename T, MmioAccess Access = MmioAccess::ReadWrite,
+          MmioEndian Endian = MmioEndian::Native>
+struct MmioRegister {
+    static_assert(std::is_same<T, uint8_t>::value || std::is_same<T, uint16_t>::value
+                  || std::is_same<T, uint32_t>::value || std::is_same<T, uint64_t>::value,
+                  "Register must be 8, 16, 32 or 64 bits wide.");
+    static_assert(Offset % sizeof(T) == 0, "Register offset is not aligned to its width.");
+
+    using value_type = T;
+    static constexpr std::size_t offset = Offset;
+    static constexpr bool readable = Access != MmioAccess::WriteOnly;
+    static constexpr bool writable = Access != MmioAccess::ReadOnly;
+
+    // ... device order <-> cpu order ...
+    static T to_cpu(T raw)   { return detail::needs_swap(Endian) ? detail::byteswap(raw) : raw; }
+    static T from_cpu(T value) { return detail::needs_swap(Endian) ? detail::byteswap(value) : value; }
+};
+
+
+template <typename Field>
+struct MmioFieldValue {
+    using field = Field;
+    using register_type = typename Field::register_type;
+    typename Field::value_type bits;    // ... shifted into place and masked ...
+};
+
+
+template <typename Register, unsigned Lsb, unsigned Width>
+struct MmioField {
+    using register_type = Register;
+    using value_type = typename Register::value_type;
+
+    static_assert(Width > 0, "Field must be at least one bit wide.");
+    static_assert(Lsb + Width <= static_cast<unsigned>(std::numeric_limits<value_type>::digits),
+                  "Field does not fit into its register.");
+
+    static constexpr unsigned lsb = Lsb;
+    static constexpr unsigned width = Width;
+    static constexpr value_type mask = static_cast<value_type>(detail::low_bits<value_type>(Width) << Lsb);
+
+    static constexpr MmioFieldValue<MmioField> of(value_type value)
+    {
+        return MmioFieldValue<MmioField>{ static_cast<value_type>((static_cast<uint64_t>(value) << Lsb) & mask) };
+    }
+    static constexpr value_type extract(value_type reg) { return static_cast<value_type>((reg & mask) >> Lsb); }
+};
+
+
+/*!
+ * A register block of Size bytes at offset of an Mmio mapping, checked against the mapping once
+ * at construction. The block base must be aligned to Align bytes, registers may not be wider.
+ * The mapping must outlive the block.
+ */
+template <std::size_t Size, std::size_t Align = 4>
+class MmioBlock {
+public:
+    explicit MmioBlock(const Mmio& mmio, std::size_t offset = 0)
+        : m_base(static_cast<uint8_t*>(mmio.ptr()) + offset)
+    {
+        if (offset + Size > mmio.size()) {
+            throw std::invalid_argument("register block larger than the mapping");
+        }
+        if (reinterpret_cast<uintptr_t>(m_base) % Align != 0) {
+            throw std::invalid_argument("register block base not aligned");
+        }
+    }
+
+    // ... whole registers ...
+    template <typename R>
+    typename R::value_type read() const
+    {
+        check<R>();
+        static_assert(R::readable, "Register is write only.");
+        return R::to_cpu(*reinterpret_cast<volatile typename R::value_type*>(m_base + R::offset));
+    }
+
+    template <typename R>
+    void write(typename R::value_type value) const
+    {
+        check<R>();
+        static_assert(R::writable, "Register is read only.");
+        *reinterpret_cast<volatile typename R::value_type*>(m_base + R::offset) = R::from_cpu(value);
+    }
+
+    // ... one field, a single load ...
+    template <typename F>
+    typename F::value_type get() const
+    {
+        return F::extract(read<typename F::register_type>());
+    }
+
+    // ... fields of one register folded into a single store, all other bits written as 0 ...
+    template <typename V, typename... Vs>
+    void write(V value, Vs... values) const
+    {
+        using R = typename V::register_type;
+        static_assert(detail::same_register<R, Vs...>::value, "Fields belong to different registers.");
+        write<R>(detail::fold_bits<typename R::value_type>(value, values...));
+    }
+
+    // ... fields of one register changed with a single load and a single store, not atomic ...
+    template <typename V, typename... Vs>
+    void modify(V value, Vs... values) const
+    {
+        using R = typename V::register_type;
+        using T = typename R::value_type;
+        static_assert(detail::same_register<R, Vs...>::value, "Fields belong to different registers.");
+        constexpr T mask = detail::fold_mask<T, V, Vs...>();
+        write<R>(static_cast<T>((read<R>() & static_cast<T>(~mask)) | detail::fold_bits<T>(value, values...)));
+    }
+
+    uint8_t* base() const { return m_base; }
+
+private:
+    uint8_t* m_base;
+
+    template <typename R>
+    static void check()
+    {
+        static_assert(R::offset + sizeof(typename R::value_type) <= Size, "Register outside of the block.");
+        static_assert(sizeof(typename R::value_type) <= Align, "Register wider than the block alignment.");
+    }
+};
+
+} // ... namespace periphery ...
+
+#endif // PERIPHERY_MMIO_REGISTER_HPP
@@ -19,18 +19,36 @@
 #include <cstdint>
 #include <cstring>
 
+#include <array>
+#include <initializer_list>
+#include <cstddef>
+#include <stdexcept>
 #include <string>
 #include <ostream>
 
+#include "periphery/buffer.hpp"
+
 namespace periphery {
 
 class Spi {
 public:
     enum class BitOrder { MsbFirst, LsbFirst };
     enum class Mode     { Zero = 0, One = 1, Two = 2, Three = 3 };
+    // ... data lines used in one direction, values are the tx_nbits / rx_nbits of a segment ...
+    enum class BusWidth { Single = 1, Dual = 2, Quad = 4, Octal = 8 };
+
+    class Segment;
+    template <std::size_t N> class Plan;
+
+    // ... chip select between the chunks of a transfer longer than max_transfer_size() ...
+    enum class ChipSelect { Hold, Toggle };
+
+    // ... largest N for which SPI_IOC_MESSAGE(N) can be encoded ...
+    static constexpr std::size_t max_segments = 511;
 
     // ... constructor / destructor ...
-    Spi(const std::string& path, Mode mode, BitOrder bit_order, uint32_t speed, uint8_t bits_per_word, uint8_t extra_flags);
+    // ... extra_flags is or-ed into the 32 bit mode word (SPI_CS_HIGH, SPI_3WIRE, SPI_TX_QUAD, ...) ...
+    Spi(const std::string& path, Mode mode, BitOrder bit_order, uint32_t speed, uint8_t bits_per_word, uint32_t extra_flags);
     Spi(const std::string& path, Mode mode, BitOrder bit_order, uint32_t speed, uint8_t bits_per_word);
     Spi(const std::string& path, Mode mode, BitOrder bit_order, uint32_t speed);
     ~Spi();
@@ -39,26 +57,161 @@ public:
     Spi(const Spi&) = delete;
     Spi& operator=(const Spi&) = delete;
 
-    // ... getters ...
+    // ... getters, from a shadow copy taken at open and refreshed by the setters, no ioctl ...
     Mode     mode() const;
     BitOrder bit_order() const;
-    uint8_t  bits_per_word() const;
-    uint32_t speed() const;
+    uint8_t  bits_per_word() const { return m_bits_per_word; }
+    uint32_t speed() const { return m_speed; }
+    // ... the 32 bit mode word as accepted, the kernel drops dual/quad/octal bits the controller lacks ...
+    uint32_t mode_flags() const { return m_mode_flags; }
+    BusWidth tx_bus_width() const;
+    BusWidth rx_bus_width() const;
 
     // ... setters ...
     void mode(Mode mode);
     void bit_order(BitOrder bit_order);
     void bits_per_word(uint8_t bits_per_word);
     void speed(uint32_t speed);
+    void mode_flags(uint32_t flags);
+    // ... widest bus the device may use, segments pick their width with tx_width() / rx_width(),
+    //     check tx_bus_width() / rx_bus_width() afterwards to see what the controller accepted ...
+    void bus_width(BusWidth tx, BusWidth rx);
 
-    // ... transfer ...
+    // ... transfer, any length, split into messages of at most max_transfer_size() bytes, CS is
+    //     held between them by default (a hint, some controllers deselect between messages anyway) ...
     void transfer(const uint8_t* txbuf, uint8_t* rxbuf, size_t len) const;
+    void transfer(const uint8_t* txbuf, uint8_t* rxbuf, size_t len, ChipSelect cs) const;
+    // ... same with speed / bits per word for this transfer only, carried in the segments instead
+    //     of changing the device setting, 0 keeps the device setting ...
+    void transfer(const uint8_t* txbuf, uint8_t* rxbuf, size_t len, uint32_t speed, uint8_t bits_per_word,
+                  ChipSelect cs = ChipSelect::Hold) const;
+
+    // ... spidev bufsiz module parameter, the most bytes one SPI_IOC_MESSAGE may transmit and the
+    //     most it may receive, read once ...
+    static std::size_t max_transfer_size();
+
+    // ... all segments in one SPI_IOC_MESSAGE(N), chip select stays asserted between segments
+    //     unless a segment asks for cs_change, the segment array is handed to the kernel as is.
+    //     The transmit and the receive lengths are each limited to max_transfer_size(), with every
+    //     segment rounded up to the kernel's kmalloc alignment, std::length_error when spidev
+    //     rejects the message ...
+    void transfer(const Segment* segments, std::size_t count) const;
+    template <std::size_t N>
+    void transfer(const Plan<N>& plan) const { transfer(plan.data(), plan.size()); }
+    void transfer(std::initializer_list<Segment> segments) const;
 
     // ... ostream ...
     friend std::ostream& operator<<(std::ostream& stream, const Spi& spi);
 
+    /*!
+     * One segment of an SPI message over caller-owned buffers, with the layout of
+     * struct spi_ioc_transfer. A missing tx buffer shifts out zeros, a missing rx buffer
+     * discards what is read. Zero speed / bits per word use the device setting.
+     */
+    class Segment {
+    public:
+        Segment()
+            : m_tx_buf(0), m_rx_buf(0), m_len(0), m_speed_hz(0), m_delay_usecs(0), m_bits_per_word(0),
+              m_cs_change(0), m_tx_nbits(0), m_rx_nbits(0), m_word_delay_usecs(0), m_pad(0) { }
+
+        static Segment write(const_buffer tx)                     { return Segment(tx.data(), nullptr, tx.size()); }
+        static Segment read(mutable_buffer rx)                    { return Segment(nullptr, rx.data(), rx.size()); }
+        static Segment transfer(const_buffer tx, mutable_buffer rx)
+        {
+            if (tx.size() != rx.size()) {
+                throw std::invalid_argument("SPI tx and rx buffers differ in size");
+            }
+            return Segment(tx.data(), rx.data(), tx.size());
+        }
+
+        // ... setters, chainable ...
+        Segment& speed(uint32_t hz)                { m_speed_hz = hz; return *this; }
+        Segment& bits_per_word(uint8_t bits)       { m_bits_per_word = bits; return *this; }
+        Segment& delay_usecs(uint16_t usecs)       { m_delay_usecs = usecs; return *this; }
+        Segment& cs_change(bool change)            { m_cs_change = change ? 1 : 0; return *this; }
+        Segment& word_delay_usecs(uint8_t usecs)   { m_word_delay_usecs = usecs; return *this; }
+        Segment& tx_width(BusWidth width)          { m_tx_nbits = static_cast<uint8_t>(width); return *this; }
+        Segment& rx_width(BusWidth width)          { m_rx_nbits = static_cast<uint8_t>(width); return *this; }
+
+        // ... getters ...
+        uint32_t    speed() const            { return m_speed_hz; }
+        uint8_t     bits_per_word() const    { return m_bits_per_word; }
+        uint16_t    delay_usecs() const      { return m_delay_usecs; }
+        bool        cs_change() const        { return m_cs_change != 0; }
+        uint8_t     word_delay_usecs() const { return m_word_delay_usecs; }
+        BusWidth    tx_width() const         { return m_tx_nbits ? static_cast<BusWidth>(m_tx_nbits) : BusWidth::Single; }
+        BusWidth    rx_width() const         { return m_rx_nbits ? static_cast<BusWidth>(m_rx_nbits) : BusWidth::Single; }
+        std::size_t size() const             { return m_len; }
+        const void* tx() const               { return reinterpret_cast<const void*>(static_cast<uintptr_t>(m_tx_buf)); }
+        void*       rx() const               { return reinterpret_cast<void*>(static_cast<uintptr_t>(m_rx_buf)); }
+
+    private:
+        Segment(const void* tx, void* rx, std::size_t len)
+            : m_tx_buf(reinterpret_cast<uintptr_t>(tx)), m_rx_buf(reinterpret_cast<uintptr_t>(rx)),
+              m_len(static_cast<uint32_t>(len)), m_speed_hz(0), m_delay_usecs(0), m_bits_per_word(0),
+              m_cs_change(0), m_tx_nbits(0), m_rx_nbits(0), m_word_delay_usecs(0), m_pad(0)
+        {
+            if (len > 0xFFFFFFFFu) {
+                throw std::invalid_argument("SPI segment longer than 4 GiB");
+            }
+        }
+
+        uint64_t m_tx_buf;
+        uint64_t m_rx_buf;
+        uint32_t m_len;
+        uint32_t m_speed_hz;
+        uint16_t m_delay_usecs;
+        uint8_t  m_bits_per_word;
+        uint8_t  m_cs_change;
+        uint8_t  m_tx_nbits;
+        uint8_t  m_rx_nbits;
+        uint8_t  m_word_delay_usecs;
+        uint8_t  m_pad;
+        friend class Spi;
+    };
+
+    /*!
+     * Up to N segments built once, usually on the stack, and sent with a single SPI_IOC_MESSAGE(N).
+     * Segments point at caller-owned buffers, refill the buffers and transfer the same plan again
+     * for the next cycle, nothing is rebuilt or allocated.
+     */
+    template <std::size_t N>
+    class Plan {
+        static_assert(N > 0 && N <= max_segments, "SPI plan must hold 1 to 511 segments.");
+    public:
+        Plan() : m_count(0) { }
+
+        Plan& write(const_buffer tx)                     { return add(Segment::write(tx)); }
+        Plan& read(mutable_buffer rx)                    { return add(Segment::read(rx)); }
+        Plan& transfer(const_buffer tx, mutable_buffer rx) { return add(Segment::transfer(tx, rx)); }
+        Plan& add(const Segment& segment)
+        {
+            if (m_count == N) {
+                throw std::length_error("SPI plan is full");
+            }
+            m_segments[m_count++] = segment;
+            return *this;
+        }
+
+        // ... in place access, e.g. to change the speed of the last added segment ...
+        Segment& operator[](std::size_t index)             { return m_segments[index]; }
+        const Segment& operator[](std::size_t index) const { return m_segments[index]; }
+        Segment& back()                                    { return m_segments[m_count - 1]; }
+
+        void clear() { m_count = 0; }
+        std::size_t size() const { return m_count; }
+        const Segment* data() const { return m_segments.data(); }
+
+    private:
+        std::array<Segment, N> m_segments;
+        std::size_t            m_count;
+    };
+
 private:
-    int  m_fd;
+    int      m_fd;
+    uint32_t m_mode_flags;
+    uint32_t m_speed;
+    uint8_t  m_bits_per_word;
 };
 
 
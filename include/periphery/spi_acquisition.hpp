@@ -0,0 +1,118 @@
+/*
+ * cpp-periphery
+ * https://github.com/mpb27/cpp-periphery
+ * License: MIT
+ *
+ * Notes:
+ *   1) A dedicated thread runs a fixed SPI plan every period, sleeping on absolute CLOCK_MONOTONIC
+ *      deadlines with clock_nanosleep() so that wake up errors do not accumulate.
+ *   2) Frames go into a ring preallocated at construction, single producer (the acquisition
+ *      thread) and single consumer, neither side locks or allocates. Only one thread at a time
+ *      may call pop() / available().
+ *   3) A full ring drops the new frame and counts an overrun, a deadline already passed by more
+ *      than a period skips the missed periods and counts them, sequence numbers show both gaps.
+ */
+
+#ifndef PERIPHERY_SPI_ACQUISITION_HPP
+#define PERIPHERY_SPI_ACQUISITION_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "periphery/buffer.hpp"
+#include "periphery/spi.hpp"
+
+namespace periphery {
+
+class SpiAcquisition {
+public:
+    // ... the transfer, Spi::transfer() normally, anything else (a fake device) for benchmarks ...
+    using TransferFunction = std::function<void(const Spi::Segment*, std::size_t)>;
+
+    struct Frame {
+        uint64_t timestamp_ns;   // ... CLOCK_MONOTONIC at the start of the transfer ...
+        uint64_t sequence;       // ... period index since start() ...
+    };
+
+    // ... bucket 0 is below 1 us of wake up lateness, bucket i is [2^(i-1), 2^i) us, the last one
+    //     collects everything above ...
+    static constexpr std::size_t histogram_buckets = 16;
+
+    // ... segments[] is copied, its rx buffers must point into frame, frame is copied into the ring
+    //     after every transfer, tx buffers and frame must outlive the acquisition ...
+    SpiAcquisition(std::shared_ptr<Spi> spi, const Spi::Segment* segments, std::size_t count,
+                   mutable_buffer frame, std::chrono::nanoseconds period, std::size_t ring_frames);
+    SpiAcquisition(TransferFunction transfer, const Spi::Segment* segments, std::size_t count,
+                   mutable_buffer frame, std::chrono::nanoseconds period, std::size_t ring_frames);
+    ~SpiAcquisition();
+
+    // ... disable copy-constructor and copy assignment ...
+    SpiAcquisition(const SpiAcquisition&) = delete;
+    SpiAcquisition& operator=(const SpiAcquisition&) = delete;
+
+    void start();
+    void stop();
+    bool running() const { return m_thread.joinable(); }
+
+    // ... SCHED_FIFO for the acquisition thread, best effort, false without the privilege ...
+    bool realtime(int priority);
+
+    // ... consumer side, lock free ...
+    bool pop(Frame& frame, mutable_buffer data);
+    std::size_t available() const;
+
+    // ... statistics, readable from any thread ...
+    std::size_t frame_size() const { return m_frame_size; }
+    std::size_t capacity() const { return m_capacity; }
+    uint64_t frames() const { return m_frames.load(std::memory_order_relaxed); }
+    uint64_t overruns() const { return m_overruns.load(std::memory_order_relaxed); }
+    uint64_t missed() const { return m_missed.load(std::memory_order_relaxed); }
+    uint64_t errors() const { return m_errors.load(std::memory_order_relaxed); }
+    std::chrono::nanoseconds max_jitter() const
+    {
+        return std::chrono::nanoseconds(m_max_jitter_ns.load(std::memory_order_relaxed));
+    }
+    std::array<uint64_t, histogram_buckets> jitter_histogram() const;
+    void reset_statistics();
+
+private:
+    TransferFunction          m_transfer;
+    std::vector<Spi::Segment> m_segments;
+    const uint8_t*            m_frame;
+    std::size_t               m_frame_size;
+    std::chrono::nanoseconds  m_period;
+
+    // ... ring, power of two slots, head written by the producer only, tail by the consumer only,
+    //     kept on separate cache lines ...
+    std::size_t               m_capacity;
+    std::vector<Frame>        m_headers;
+    std::vector<uint8_t>      m_data;
+    std::atomic<std::size_t>  m_head;
+    char                      m_pad0[64];
+    std::atomic<std::size_t>  m_tail;
+    char                      m_pad1[64];
+
+    std::atomic<bool>         m_stop;
+    std::atomic<uint64_t>     m_frames;
+    std::atomic<uint64_t>     m_overruns;
+    std::atomic<uint64_t>     m_missed;
+    std::atomic<uint64_t>     m_errors;
+    std::atomic<uint64_t>     m_max_jitter_ns;
+    std::array<std::atomic<uint64_t>, histogram_buckets> m_histogram;
+    std::thread               m_thread;
+
+    void run();
+    void record_jitter(uint64_t late_ns);
+};
+
+} // ... namespace periphery ...
+
+#endif // PERIPHERY_SPI_ACQUISITION_HPP
@@ -0,0 +1,120 @@
+/*
+ * cpp-periphery
+ * https://github.com/mpb27/cpp-periphery
+ * License: MIT
+ *
+ * Notes:
+ *   1) MIPI DCS panels (ILI9341, ST7789, ...) in 16 bit RGB565 mode, D/C on a GpioPin.
+ *   2) The caller draws into framebuffer() (RGB888 or host order RGB565) and marks what changed,
+ *      present() merges the dirty rectangles into a few windows, converts them to big endian
+ *      RGB565 into one of two transmit buffers and hands that buffer to a worker thread. The next
+ *      frame is drawn while the previous one is on the wire, present() only blocks when both
+ *      transmit buffers are still queued.
+ *   3) D/C can only change between SPI messages, it is switched only when it actually changes and
+ *      CASET / RASET are skipped when the window columns / rows did not change.
+ *   4) One rendering thread, framebuffer(), mark_dirty(), present() and command() are not meant to
+ *      be called concurrently.
+ */
+
+#ifndef PERIPHERY_SPI_DISPLAY_HPP
+#define PERIPHERY_SPI_DISPLAY_HPP
+
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "periphery/buffer.hpp"
+#include "periphery/gpio.hpp"
+#include "periphery/spi.hpp"
+
+namespace periphery {
+
+class SpiDisplay {
+public:
+    enum class SourceFormat { Rgb888, Rgb565 };
+
+    struct Rect {
+        uint16_t x, y, w, h;
+    };
+
+    // ... windows per frame after merging, small rectangles beyond this are merged anyway ...
+    static constexpr std::size_t max_windows = 16;
+
+    SpiDisplay(std::shared_ptr<Spi> spi, std::shared_ptr<GpioPin> dc, uint16_t width, uint16_t height,
+               SourceFormat format = SourceFormat::Rgb888);
+    ~SpiDisplay();
+
+    // ... disable copy-constructor and copy assignment ...
+    SpiDisplay(const SpiDisplay&) = delete;
+    SpiDisplay& operator=(const SpiDisplay&) = delete;
+
+    // ... panel RAM offset of pixel (0, 0), for panels smaller than their controller ...
+    void offset(uint16_t x, uint16_t y);
+
+    // ... rendering side ...
+    uint8_t* framebuffer() { return m_source.data(); }
+    std::size_t stride() const { return m_width * m_bpp; }
+    uint16_t width() const { return m_width; }
+    uint16_t height() const { return m_height; }
+    void mark_dirty(Rect rect);
+    void invalidate() { mark_dirty(Rect{ 0, 0, m_width, m_height }); }
+    void present();
+    void wait_idle();
+
+    // ... raw command with parameters, waits for queued frames first ...
+    void command(uint8_t cmd, const_buffer params = const_buffer());
+
+    // ... statistics ...
+    uint64_t frames() const;
+    uint64_t windows() const;
+    uint64_t pixel_bytes() const;
+
+private:
+    struct Frame {
+        std::size_t       index;
+        std::vector<Rect> rects;
+    };
+
+    std::shared_ptr<Spi>     m_spi;
+    std::shared_ptr<GpioPin> m_dc;
+    uint16_t                 m_width;
+    uint16_t                 m_height;
+    SourceFormat             m_format;
+    std::size_t              m_bpp;
+    uint16_t                 m_offset_x;
+    uint16_t                 m_offset_y;
+    std::vector<uint8_t>     m_source;
+    std::vector<Rect>        m_dirty;
+
+    // ... worker side, the D/C level and the last window are only touched with the worker idle ...
+    std::array<std::vector<uint8_t>, 2> m_tx;
+    std::array<bool, 2>      m_tx_busy;
+    std::deque<Frame>        m_queue;
+    mutable std::mutex       m_mutex;
+    std::condition_variable  m_cv;
+    bool                     m_stop;
+    std::exception_ptr       m_error;
+    int                      m_dc_level;
+    Rect                     m_window;
+    uint64_t                 m_frames;
+    uint64_t                 m_windows;
+    uint64_t                 m_pixel_bytes;
+    std::thread              m_thread;
+
+    void run();
+    void send(bool data, const uint8_t* bytes, std::size_t len);
+    void send_window(const Rect& rect, const uint8_t* pixels);
+    void convert(const Rect& rect, uint8_t* dst) const;
+    void rethrow();
+};
+
+} // ... namespace periphery ...
+
+#endif // PERIPHERY_SPI_DISPLAY_HPP
@@ -0,0 +1,134 @@
+/*
+ * cpp-periphery
+ * https://github.com/mpb27/cpp-periphery
+ * License: MIT
+ *
+ * Notes:
+ *   1) Geometry and fast read opcodes come from the SFDP basic flash parameter table (JESD216)
+ *      when the part has one, otherwise from the JEDEC ID with the common defaults (256 byte
+ *      pages, 4 KiB sectors erased with 0x20, capacity 2^id[2], 0x20 - 0x22 being 64 - 256 MiB).
+ *   2) Parts above 16 MiB use the stateless 4 byte opcodes (0x13, 0x0C, 0x3C, 0x6C, 0xEC, 0x12,
+ *      0x21, ...) when the SFDP 4 byte address instruction table lists them, so a reset of the
+ *      part cannot desynchronize the address mode. Otherwise the part is switched to 4 byte
+ *      address mode with EN4B in the constructor, construct a new SpiFlash after resetting it.
+ *   3) A page program or sector erase is one SPI message, WREN + RDSR + command + data followed by
+ *      a train of spaced RDSR polls, most operations complete without a second ioctl. A missing
+ *      write enable latch, a command the part ignored (WEL still set) and the vendor program /
+ *      erase fail flags (Spansion SR1, Micron flag status, Macronix security register) throw
+ *      std::runtime_error.
+ *   4) Dual / quad reads need the Spi configured with bus_width() first. Quad modes set the Quad
+ *      Enable bit as described by the SFDP QER field first (non volatile, only written when
+ *      clear, the other status bits are kept), without SFDP 1.5 QER they throw
+ *      std::invalid_argument. QER 1 / 4 parts that do not answer the SR2 read (0x35) get QE
+ *      written on every construction and the rest of SR2 cleared.
+ */
+
+#ifndef PERIPHERY_SPI_FLASH_HPP
+#define PERIPHERY_SPI_FLASH_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "periphery/buffer.hpp"
+#include "periphery/periphery.hpp"
+#include "periphery/spi.hpp"
+
+namespace periphery {
+
+class SpiFlash {
+public:
+    enum class ReadMode {
+        Slow,           // ... 0x03, no dummy, low clock rates only ...
+        Fast,           // ... 0x0B, 1-1-1 ...
+        DualOutput,     // ... 0x3B, 1-1-2 ...
+        QuadOutput,     // ... 0x6B, 1-1-4 ...
+        QuadIO          // ... 0xEB, 1-4-4 ...
+    };
+
+    struct Info {
+        uint8_t  manufacturer;
+        uint16_t device;
+        uint64_t size;
+        uint32_t page_size;
+        uint32_t sector_size;
+        uint8_t  sector_erase_opcode;
+        unsigned address_bytes;
+        bool     sfdp;
+        bool     dual_output;
+        bool     quad_output;
+        bool     quad_io;
+        uint8_t  quad_enable;       // ... SFDP QER method 0 - 6, quad_enable_unknown without it ...
+    };
+
+    static constexpr uint8_t quad_enable_unknown = 0xFF;
+
+    explicit SpiFlash(std::shared_ptr<Spi> spi, ReadMode mode = ReadMode::Fast);
+
+    // ... disable copy-constructor and copy assignment ...
+    SpiFlash(const SpiFlash&) = delete;
+    SpiFlash& operator=(const SpiFlash&) = delete;
+
+    const Info& info() const { return m_info; }
+
+    // ... throws std::invalid_argument when the part or the controller lacks the bus width, or a
+    //     quad mode has no known quad enable method ...
+    void read_mode(ReadMode mode);
+    ReadMode read_mode() const { return m_mode; }
+
+    // ... streaming read straight into data, one command per spidev bufsiz ...
+    void read(uint64_t address, mutable_buffer data) const;
+
+    // ... program any range, split on page boundaries, the range must be erased ...
+    void program(uint64_t address, const_buffer data);
+
+    // ... erase the sectors covering [address, address + len), address must be sector aligned ...
+    void erase(uint64_t address, std::size_t len);
+    void erase_sector(uint64_t address);
+    void erase_chip();
+
+    uint8_t status() const;
+    bool busy() const { return (status() & 0x01) != 0; }
+    // ... throws timeout_exception ...
+    void wait_ready(std::chrono::milliseconds timeout) const;
+
+private:
+    struct ReadCommand {
+        uint8_t  opcode;
+        unsigned dummy_bytes;       // ... mode + dummy clocks as bytes on the address lines ...
+        Spi::BusWidth address_width;
+        Spi::BusWidth data_width;
+    };
+
+    std::shared_ptr<Spi> m_spi;
+    Info                 m_info;
+    ReadMode             m_mode;
+    ReadCommand          m_read;
+    ReadCommand          m_sfdp_read[3];   // ... 1-1-2, 1-1-4, 1-4-4 as described by SFDP ...
+    uint32_t             m_4bait;          // ... 4 byte address instruction table DWORD 1, 0 if absent ...
+    uint8_t              m_erase4_opcode;  // ... 4 byte opcode of the sector erase ...
+    uint8_t              m_4byte_entry;    // ... BFPT DWORD 16 bits 31:24, EN4B methods ...
+    bool                 m_4byte_only;     // ... always in 4 byte address mode ...
+    bool                 m_4byte_opcodes;  // ... stateless 4 byte opcodes, else 3 byte opcodes in 4 byte mode ...
+    bool                 m_quad_enabled;
+    uint8_t              m_fail_mask;      // ... status register bits that flag a failed program / erase ...
+
+    void identify();
+    bool read_sfdp();
+    void setup_addressing();
+    void enable_quad();
+    void sfdp_read(uint32_t address, mutable_buffer data) const;
+    std::size_t encode_address(uint8_t* dst, uint64_t address) const;
+    uint8_t opcode4(uint8_t opcode3, uint8_t opcode4) const { return m_4byte_opcodes ? opcode4 : opcode3; }
+    uint8_t read_register(uint8_t opcode) const;
+    void command(uint8_t opcode) const;
+    void write_register(const uint8_t* bytes, std::size_t len);
+    void write_and_poll(const Spi::Segment* segments, std::size_t count, uint16_t poll_delay_us,
+                        std::chrono::milliseconds timeout);
+    void check_result(uint8_t status) const;
+};
+
+} // ... namespace periphery ...
+
+#endif // PERIPHERY_SPI_FLASH_HPP
@@ -0,0 +1,54 @@
+/*
+ * cpp-periphery
+ * https://github.com/mpb27/cpp-periphery
+ * License: MIT
+ *
+ * Notes:
+ *   1) Packed word streams as sent by ADCs / DACs on an 8 bit SPI transfer, words of 1 to 32 bits
+ *      back to back without padding, the last byte padded with zeros.
+ *        Big    - MSB of each word first, MSB of each byte first (the usual SPI wire order).
+ *        Little - LSB of each word first, byte 0 holds the first 8 bits of the stream.
+ *   2) Words up to 25 bits are unpacked with SSE4.1 / AVX2 / NEON, words of an even size from 8 to
+ *      24 bits are packed with SSE4.1 / NEON (AVX2 uses the SSE4.1 code), everything else goes
+ *      through a scalar bit accumulator. The implementation is
+ *      picked once at runtime from the CPU features.
+ *   3) Unsigned 16 bit words unpacked into int16_t keep their bit pattern.
+ *   4) The NEON code (here and in SpiDisplay) is only built with PERIPHERY_NEON, aarch64 builds
+ *      stay scalar by default until test-spi-pack passed on the target.
+ */
+
+#ifndef PERIPHERY_SPI_PACK_HPP
+#define PERIPHERY_SPI_PACK_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace periphery {
+
+enum class WordEndian { Big, Little };
+enum class SpiPackIsa { Scalar, Sse41, Avx2, Neon };
+
+// ... bytes taken by count packed words of bits each ...
+inline std::size_t spi_packed_size(std::size_t count, unsigned bits) { return (count * bits + 7) / 8; }
+
+// ... packed stream to words, is_signed sign extends from the top bit of each word, int16_t output
+//     takes words of at most 16 bits ...
+void spi_unpack(const uint8_t* src, int16_t* dst, std::size_t count, unsigned bits, WordEndian endian, bool is_signed);
+void spi_unpack(const uint8_t* src, int32_t* dst, std::size_t count, unsigned bits, WordEndian endian, bool is_signed);
+
+// ... words to packed stream, bits above the word size are ignored, dst holds spi_packed_size() bytes ...
+void spi_pack(const int16_t* src, uint8_t* dst, std::size_t count, unsigned bits, WordEndian endian);
+void spi_pack(const int32_t* src, uint8_t* dst, std::size_t count, unsigned bits, WordEndian endian);
+
+// ... LSB first in software for controllers without SPI_LSB_FIRST, in place or src to dst ...
+void spi_reverse_bits(uint8_t* data, std::size_t len);
+void spi_reverse_bits(const uint8_t* src, uint8_t* dst, std::size_t len);
+
+// ... implementation in use, the setter is for benchmarks, it falls back to what the CPU supports
+//     and returns what was selected, not thread safe against concurrent pack / unpack calls ...
+SpiPackIsa spi_pack_isa();
+SpiPackIsa spi_pack_isa(SpiPackIsa isa);
+
+} // ... namespace periphery ...
+
+#endif // PERIPHERY_SPI_PACK_HPP
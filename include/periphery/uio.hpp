@@ -0,0 +1,82 @@
+/*
+ * cpp-periphery
+ * https://github.com/mpb27/cpp-periphery
+ * License: MIT
+ *
+ * Notes:
+ *   1) Userspace I/O (drivers/uio) device, every map of the device is an Mmio and registers
+ *      are accessed without syscalls. Interrupts are the only thing going through the fd.
+ *   2) read() of /dev/uioN returns the total interrupt count, wait() reports how many arrived
+ *      since the previous wait and counts the ones that were merged into a single wakeup as
+ *      missed. Most UIO drivers mask the line in the handler, enable_irq() unmasks it again
+ *      (write of 1), call it before each wait().
+ *   3) Example:
+ *          Uio uio(Uio::find("my-fpga-ip"));
+ *          uio.enable_irq();
+ *          while (uio.wait(std::chrono::milliseconds(100))) {
+ *              uio.map(0).write32(IRQ_ACK, 1);
+ *              uio.enable_irq();
+ *          }
+ */
+
+#ifndef PERIPHERY_UIO_HPP
+#define PERIPHERY_UIO_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "periphery/mmio.hpp"
+
+namespace periphery {
+
+class Uio {
+public:
+    explicit Uio(unsigned device, Mmio::MapOptions options = Mmio::MapOptions{ false, false, false });
+    ~Uio();
+
+    // ... disable copy-constructor and copy assignment ...
+    Uio(const Uio&) = delete;
+    Uio& operator=(const Uio&) = delete;
+
+    // ... device number of the uio named name in sysfs, throws std::invalid_argument ...
+    static unsigned find(const std::string& name);
+
+    unsigned device() const { return m_device; }
+    const std::string& name() const { return m_name; }
+    int fd() const { return m_fd; }
+
+    // ... mapped regions, throws std::out_of_range ...
+    std::size_t maps() const { return m_maps.size(); }
+    const Mmio& map(std::size_t index) const;
+
+    // ... interrupt control, needs a driver with irqcontrol ...
+    void enable_irq() const;
+    void disable_irq() const;
+
+    // ... new interrupts since the last wait, blocking, or 0 on timeout ...
+    uint32_t wait();
+    uint32_t wait(std::chrono::milliseconds timeout);
+
+    // ... total count seen by the last wait, and interrupts that did not get their own wakeup ...
+    uint32_t count() const { return m_count; }
+    uint64_t missed() const { return m_missed; }
+
+private:
+    unsigned                           m_device;
+    std::string                        m_name;
+    int                                m_fd;
+    std::vector<std::unique_ptr<Mmio>> m_maps;
+    uint32_t                           m_count;
+    uint64_t                           m_missed;
+
+    void irq_control(int32_t value) const;
+    uint32_t consume();
+};
+
+} // ... namespace periphery ...
+
+#endif // PERIPHERY_UIO_HPP
@@ -0,0 +1,159 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "periphery/mmio.hpp"
+
+using namespace periphery;
+using clock_type = std::chrono::steady_clock;
+
+// ... runs f (which does 64 accesses) for about 200 ms, returns ns per access ...
+template <typename F>
+static double per_access(F f)
+{
+    std::size_t runs = 0;
+    auto start = clock_type::now();
+    auto end = start + std::chrono::milliseconds(200);
+    do {
+        f();
+        runs++;
+    } while (clock_type::now() < end);
+    double seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+    return seconds * 1e9 / (runs * 64.0);
+}
+
+// ... threads each toggle their own bit of one register, returns ns per operation per thread ...
+template <typename F>
+static double contended(unsigned threads, unsigned ops, F f)
+{
+    std::vector<std::thread> workers;
+    auto start = clock_type::now();
+    for (unsigned t = 0; t < threads; t++) {
+        workers.emplace_back([=] {
+            for (unsigned i = 0; i < ops; i++) {
+                f(t, true);
+                f(t, false);
+            }
+        });
+    }
+    for (auto& w : workers) {
+        w.join();
+    }
+    double seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+    return seconds * 1e9 / (2.0 * ops);
+}
+
+// ... usage: bench-mmio [base] [size], /dev/mem needs root, point it at RAM or a side effect free
+//     register block, without a base a memfd stands in for the device ...
+int main(int argc, char* argv[])
+{
+    std::size_t size = argc > 2 ? std::strtoul(argv[2], nullptr, 0) : 0x1000;
+
+    std::unique_ptr<Mmio> mapping;
+    if (argc > 1) {
+        mapping.reset(new Mmio(static_cast<uintptr_t>(std::strtoull(argv[1], nullptr, 0)), size));
+    } else {
+        int fd = memfd_create("bench-mmio", 0);
+        if (fd < 0 || ftruncate(fd, static_cast<off_t>(size)) < 0) {
+            std::cerr << "memfd_create failed" << std::endl;
+            return 1;
+        }
+        mapping.reset(new Mmio(Mmio::fd_region(fd, 0, size)));
+        std::cout << "memfd stand-in" << std::endl;
+    }
+    const Mmio& mmio = *mapping;
+    const std::size_t words = size / 4 < 64 ? size / 4 : 64;
+    if (words == 0) {
+        std::cerr << "size must be at least 4 bytes" << std::endl;
+        return 1;
+    }
+
+#ifdef NDEBUG
+    std::cout << "read32 checked, view index checks off (NDEBUG)" << std::endl;
+#else
+    std::cout << "read32 checked, view index checks on, configure with -DCMAKE_BUILD_TYPE=Release to drop them"
+              << std::endl;
+#endif
+
+    volatile uint32_t* raw = static_cast<volatile uint32_t*>(mmio.ptr());
+    auto view = mmio.view<uint32_t>(0, words);
+    uint32_t sink = 0;
+
+    double r_raw = per_access([&] {
+        for (std::size_t i = 0; i < 64; i++) sink += raw[i % words];
+    });
+    double r_read = per_access([&] {
+        for (std::size_t i = 0; i < 64; i++) sink += mmio.read32((i % words) * 4);
+    });
+    double r_view = per_access([&] {
+        for (std::size_t i = 0; i < 64; i++) sink += view[i % words];
+    });
+    double w_raw = per_access([&] {
+        for (std::size_t i = 0; i < 64; i++) raw[i % words] = raw[i % words];
+    });
+    double w_write = per_access([&] {
+        for (std::size_t i = 0; i < 64; i++) mmio.write32((i % words) * 4, mmio.read32((i % words) * 4));
+    });
+
+    std::cout << "read   raw pointer " << r_raw   << " ns" << std::endl;
+    std::cout << "read   read32()    " << r_read  << " ns" << std::endl;
+    std::cout << "read   view<>[]    " << r_view  << " ns" << std::endl;
+    std::cout << "rmw    raw pointer " << w_raw   << " ns" << std::endl;
+    std::cout << "rmw    read/write  " << w_write << " ns" << std::endl;
+    std::cout << "(" << sink << ")" << std::endl;
+
+    // ... contention, every thread owns one bit of the register at offset 0 ...
+    unsigned threads = std::thread::hardware_concurrency();
+    threads = threads < 2 ? 2 : (threads > 8 ? 8 : threads);
+    const unsigned ops = 100000;
+    std::mutex mutex;
+    bool ok = true;
+
+    mmio.write32(0, 0);
+    double c_mutex = contended(threads, ops, [&](unsigned t, bool on) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (on) mmio.set32(0, 1u << t); else mmio.clear32(0, 1u << t);
+    });
+    ok = ok && mmio.read32(0) == 0;
+    double c_modify = contended(threads, ops, [&](unsigned t, bool on) {
+        mmio.modify32(0, on ? 0 : 1u << t, on ? 1u << t : 0);
+    });
+    ok = ok && mmio.read32(0) == 0;
+
+    std::cout << threads << " threads" << std::endl;
+    std::cout << "rmw    mutex       " << c_mutex  << " ns" << std::endl;
+    std::cout << "rmw    modify32()  " << c_modify << " ns" << std::endl;
+
+    // ... lock free only on RAM ...
+    if (argc <= 1) {
+        double c_atomic = contended(threads, ops, [&](unsigned t, bool on) {
+            mmio.atomic_modify32(0, on ? 0 : 1u << t, on ? 1u << t : 0);
+        });
+        ok = ok && mmio.read32(0) == 0;
+        std::cout << "rmw    atomic      " << c_atomic << " ns" << std::endl;
+    }
+
+    // ... compare and wait, a second thread sets the bit ...
+    mmio.write32(0, 0);
+    auto setter_start = clock_type::now();
+    std::thread setter([&] { mmio.modify32(0, 0, 0x100); });
+    bool seen = mmio.wait32(0, 0x100, 0x100, std::chrono::seconds(1));
+    double latency = std::chrono::duration<double>(clock_type::now() - setter_start).count() * 1e6;
+    setter.join();
+    ok = ok && seen && !mmio.wait32(0, 0x1, 0x1, std::chrono::microseconds(100));
+    std::cout << "wait32 seen after  " << latency << " us" << std::endl;
+
+    if (!ok) {
+        std::cout << "MISMATCH" << std::endl;
+        return 1;
+    }
+}
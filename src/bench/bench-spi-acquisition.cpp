@@ -0,0 +1,70 @@
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#include "periphery/spi_acquisition.hpp"
+
+// ... usage: bench-spi-acquisition [rate_hz] [seconds] [device], without a device the transfer
+//     is a fake spidev that fills the frame and spins for the wire time of 3 bytes at 10 MHz ...
+int main(int argc, char* argv[])
+{
+    using namespace periphery;
+    using clock = std::chrono::steady_clock;
+
+    long rate = argc > 1 ? std::strtol(argv[1], nullptr, 0) : 10000;
+    long seconds = argc > 2 ? std::strtol(argv[2], nullptr, 0) : 2;
+
+    // ... MCP3008 style single ended read of channel 0 ...
+    std::array<uint8_t, 3> tx = {{0x01, 0x80, 0x00}};
+    std::array<uint8_t, 3> rx;
+    auto segment = Spi::Segment::transfer(buffer(tx), buffer(rx));
+    auto period = std::chrono::nanoseconds(1000000000L / rate);
+
+    std::unique_ptr<SpiAcquisition> acq;
+    if (argc > 3) {
+        auto spi = std::make_shared<Spi>(argv[3], Spi::Mode::Zero, Spi::BitOrder::MsbFirst, 1000000);
+        acq.reset(new SpiAcquisition(spi, &segment, 1, buffer(rx), period, 4096));
+    } else {
+        uint16_t counter = 0;
+        auto fake = [&counter](const Spi::Segment* s, std::size_t n) {
+            auto end = clock::now() + std::chrono::nanoseconds(2400);
+            for (std::size_t i = 0; i < n; i++) {
+                std::memset(s[i].rx(), static_cast<int>(counter & 0xFF), s[i].size());
+            }
+            counter++;
+            while (clock::now() < end) { }
+        };
+        acq.reset(new SpiAcquisition(fake, &segment, 1, buffer(rx), period, 4096));
+    }
+
+    acq->start();
+    acq->realtime(50);
+
+    SpiAcquisition::Frame frame;
+    std::array<uint8_t, 3> data;
+    uint64_t consumed = 0;
+    auto end = clock::now() + std::chrono::seconds(seconds);
+    while (clock::now() < end) {
+        while (acq->pop(frame, buffer(data))) {
+            consumed++;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    acq->stop();
+
+    std::cout << "frames = " << acq->frames() << " (" << acq->frames() / seconds << "/s of " << rate << "/s)"
+              << ", consumed = " << consumed << ", overruns = " << acq->overruns()
+              << ", missed = " << acq->missed() << ", errors = " << acq->errors()
+              << ", max jitter = " << acq->max_jitter().count() / 1000 << " us" << std::endl;
+
+    auto histogram = acq->jitter_histogram();
+    for (std::size_t i = 0; i < histogram.size(); i++) {
+        if (histogram[i] != 0) {
+            std::cout << "  < " << (1u << i) << " us : " << histogram[i] << std::endl;
+        }
+    }
+}
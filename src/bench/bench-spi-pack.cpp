@@ -0,0 +1,105 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "periphery/spi_pack.hpp"
+
+using namespace periphery;
+using clock_type = std::chrono::steady_clock;
+
+static const char* isa_name(SpiPackIsa isa)
+{
+    switch (isa) {
+        case SpiPackIsa::Sse41: return "sse4.1";
+        case SpiPackIsa::Avx2:  return "avx2";
+        case SpiPackIsa::Neon:  return "neon";
+        default:                return "scalar";
+    }
+}
+
+// ... runs f repeatedly for about 200 ms, returns million words (or bytes) per second ...
+template <typename F>
+static double rate(std::size_t items, F f)
+{
+    std::size_t runs = 0;
+    auto start = clock_type::now();
+    auto end = start + std::chrono::milliseconds(200);
+    do {
+        f();
+        runs++;
+    } while (clock_type::now() < end);
+    double seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+    return items * runs / seconds / 1e6;
+}
+
+template <typename T>
+static void bench_words(unsigned bits, WordEndian endian, SpiPackIsa best, bool& ok)
+{
+    const std::size_t count = 1 << 16;
+    std::vector<uint8_t> packed(spi_packed_size(count, bits) + 1);
+    std::vector<T> words(count), expect(count), back(count);
+    std::vector<uint8_t> repacked(packed.size());
+
+    std::mt19937 rng(bits);
+    for (auto& b : packed) {
+        b = static_cast<uint8_t>(rng());
+    }
+    packed.back() = 0;
+
+    double r[2][2];
+    SpiPackIsa isas[2] = { SpiPackIsa::Scalar, best };
+    for (int i = 0; i < 2; i++) {
+        spi_pack_isa(isas[i]);
+        r[i][0] = rate(count, [&] { spi_unpack(packed.data(), words.data(), count, bits, endian, true); });
+        r[i][1] = rate(count, [&] { spi_pack(words.data(), repacked.data(), count, bits, endian); });
+        if (i == 0) {
+            expect = words;
+        } else if (words != expect) {
+            ok = false;
+        }
+        // ... unpacking sign extends, packing must give the original stream back, except the padding ...
+        spi_unpack(repacked.data(), back.data(), count, bits, endian, true);
+        if (back != expect) {
+            ok = false;
+        }
+    }
+
+    std::cout << (sizeof(T) == 2 ? "int16 " : "int32 ") << bits << " bit " << (endian == WordEndian::Big ? "BE" : "LE")
+              << "  unpack " << r[0][0] << " -> " << r[1][0] << " Mwords/s"
+              << ",  pack " << r[0][1] << " -> " << r[1][1] << " Mwords/s" << std::endl;
+}
+
+int main()
+{
+    SpiPackIsa best = spi_pack_isa();
+    std::cout << "scalar -> " << isa_name(best) << std::endl;
+
+    bool ok = true;
+    const unsigned sizes[] = { 10, 12, 14, 18, 24 };
+    const WordEndian endians[] = { WordEndian::Big, WordEndian::Little };
+    for (auto endian : endians) {
+        for (auto bits : sizes) {
+            if (bits <= 16) {
+                bench_words<int16_t>(bits, endian, best, ok);
+            }
+            bench_words<int32_t>(bits, endian, best, ok);
+        }
+    }
+
+    std::vector<uint8_t> data(1 << 16), ref(data.size()), out(data.size());
+    for (std::size_t i = 0; i < data.size(); i++) {
+        data[i] = static_cast<uint8_t>(i * 7);
+    }
+    spi_pack_isa(SpiPackIsa::Scalar);
+    double scalar = rate(data.size(), [&] { spi_reverse_bits(data.data(), ref.data(), data.size()); });
+    spi_pack_isa(best);
+    double simd = rate(data.size(), [&] { spi_reverse_bits(data.data(), out.data(), data.size()); });
+    ok = ok && out == ref;
+    std::cout << "reverse bits  " << scalar << " -> " << simd << " MB/s" << std::endl;
+
+    std::cout << (ok ? "results match" : "MISMATCH") << std::endl;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,39 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "periphery/spi.hpp"
+
+// ... usage: bench-spi [device] [speed_hz] [megabytes] ...
+int main(int argc, char* argv[])
+{
+    using namespace periphery;
+    using clock = std::chrono::steady_clock;
+
+    std::string path = argc > 1 ? argv[1] : "/dev/spidev0.0";
+    uint32_t speed = argc > 2 ? static_cast<uint32_t>(std::strtoul(argv[2], nullptr, 0)) : 10000000;
+    std::size_t megabytes = argc > 3 ? std::strtoul(argv[3], nullptr, 0) : 4;
+
+    Spi spi(path, Spi::Mode::Zero, Spi::BitOrder::MsbFirst, speed);
+
+    std::vector<uint8_t> tx(megabytes << 20, 0xA5);
+    std::vector<uint8_t> rx(tx.size());
+
+    std::cout << "bufsiz = " << Spi::max_transfer_size() << ", "
+              << (tx.size() + Spi::max_transfer_size() - 1) / Spi::max_transfer_size() << " messages" << std::endl;
+
+    const Spi::ChipSelect modes[] = { Spi::ChipSelect::Hold, Spi::ChipSelect::Toggle };
+    for (auto cs : modes) {
+        auto start = clock::now();
+        spi.transfer(tx.data(), rx.data(), tx.size(), cs);
+        auto elapsed = std::chrono::duration<double>(clock::now() - start).count();
+
+        double rate = tx.size() / elapsed;
+        double wire = speed / 8.0;
+        std::cout << (cs == Spi::ChipSelect::Hold ? "hold   " : "toggle ")
+                  << rate / 1e6 << " MB/s, " << 100.0 * rate / wire << " % of wire speed" << std::endl;
+    }
+}
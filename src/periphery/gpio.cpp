@@ -9,10 +9,14 @@
  */
 
 // C++11 headers:
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
 #include <cstdlib>
 #include <cstdint>
 #include <cstring>
 #include <iostream>
+#include <stdexcept>
 #include <string>
 #include <system_error>
 #include <vector>
@@ -31,11 +35,31 @@
 
 namespace periphery {
 
-    auto to_request(GpioPin::Edge edge) -> unsigned long;
-    auto to_request(GpioPin::Bias bias) -> unsigned long;
-    auto to_request(GpioPin::Drive drive) -> unsigned long;
-    auto to_request(GpioPin::Invert invert) -> unsigned long;
-    auto to_request(GpioPin::Direction direction) -> unsigned  long;
+    auto to_v2_flags(GpioPin::Direction direction, GpioPin::Edge edge, GpioPin::Bias bias, GpioPin::Drive drive,
+                     GpioPin::Invert invert, GpioPin::EventClock clock) -> uint64_t;
+    auto to_v2_flags(const GpioLines::LineConfig& config) -> uint64_t;
+    auto is_output(GpioPin::Direction direction) -> bool;
+    auto initial_value(GpioPin::Direction direction, GpioPin::Invert invert) -> bool;
+    void build_line_config(const GpioLines::LineConfig* configs, std::size_t count, uint64_t& values,
+                           struct gpio_v2_line_config& config, bool debounce);
+    auto has_debounce(const GpioLines::LineConfig* configs, std::size_t count) -> bool;
+    auto keep_levels(int fd, const GpioLines::LineConfig* from, const GpioLines::LineConfig* to, std::size_t count,
+                     uint64_t values) -> uint64_t;
+    auto debounce_unsupported(int error) -> bool;
+    auto setup_debounce(int fd, const GpioLines::LineConfig* configs, const unsigned int* lines, std::size_t count,
+                        bool enable) -> std::vector<GpioDebounceLine>;
+    auto has_debounced_events(const std::vector<GpioDebounceLine>& lines) -> bool;
+    auto read_debounced_events(int fd, GpioPin::Event* events, std::size_t count, std::vector<GpioDebounceLine>& lines,
+                               uint32_t& last_seqno, uint64_t& dropped) -> std::size_t;
+    auto read_line_events(int fd, GpioPin::Event* events, std::size_t count,
+                          uint32_t& last_seqno, uint64_t& dropped) -> std::size_t;
+    auto wait_line_events(int fd, std::chrono::milliseconds timeout) -> bool;
+
+    // ... Event is read straight from the line fd, so it must match the kernel's layout ...
+    static_assert(sizeof(GpioPin::Event) == sizeof(struct gpio_v2_line_event), "GpioPin::Event size mismatch");
+    static_assert(offsetof(GpioPin::Event, id) == offsetof(struct gpio_v2_line_event, id), "GpioPin::Event layout mismatch");
+    static_assert(offsetof(GpioPin::Event, seqno) == offsetof(struct gpio_v2_line_event, seqno), "GpioPin::Event layout mismatch");
+    static_assert(offsetof(GpioPin::Event, line_seqno) == offsetof(struct gpio_v2_line_event, line_seqno), "GpioPin::Event layout mismatch");
 
 
     GpioChip::GpioChip(const std::string &path)
@@ -53,6 +77,7 @@ namespace periphery {
             close(m_fd);
             throw e;
         }
+        m_lines = chip_info.lines;
     }
 
     GpioChip::~GpioChip() {
@@ -63,9 +88,10 @@ namespace periphery {
 
     auto GpioPin::get() const -> GpioPin::State
     {
-        struct gpiohandle_data data = {};
+        struct gpio_v2_line_values data = {};
+        data.mask = 1;
 
-        auto success = ioctl(m_fd, GPIOHANDLE_GET_LINE_VALUES_IOCTL, &data);
+        auto success = ioctl(m_fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &data);
         if (success < 0)
         {
             //ec.assign(-success, std::system_category());
@@ -73,96 +99,121 @@ namespace periphery {
             throw std::system_error(EFAULT, std::system_category(), "Failed to read pin state.");
         }
 
-        return data.values[0] ? GpioPin::State::High : GpioPin::State::Low;
+        return (data.bits & 1) ? GpioPin::State::High : GpioPin::State::Low;
     }
 
     void GpioPin::set(State value)
     {
-        struct gpiohandle_data data = {};
+        struct gpio_v2_line_values data = {};
 
-        data.values[0] = value == State::High ? 1 : 0;
+        data.mask = 1;
+        data.bits = value == State::High ? 1 : 0;
 
-        auto success = ioctl(m_fd, GPIOHANDLE_SET_LINE_VALUES_IOCTL, &data);
+        auto success = ioctl(m_fd, GPIO_V2_LINE_SET_VALUES_IOCTL, &data);
         if (success < 0)
         {
             throw std::system_error(EFAULT, std::system_category(), "Failed to write pin state.");
         }
+
+        m_value = (value == State::High);
     }
 
-    void GpioPin::reopen(GpioPin::Direction direction, GpioPin::Edge edge, GpioPin::Bias bias, GpioPin::Drive drive, GpioPin::Invert invert)
+    auto GpioPin::read_events(GpioPin::Event* events, std::size_t count) -> std::size_t
     {
-        uint32_t flags = to_request(bias) | to_request(drive) | to_request(invert) | to_request(direction);
+        if (m_soft_debounce) {
+            return read_debounced_events(m_fd, events, count, m_debounce_lines, m_last_seqno, m_dropped);
+        }
+        return read_line_events(m_fd, events, count, m_last_seqno, m_dropped);
+    }
 
-        if (m_fd >= 0)
-        {
-            auto success = close(m_fd);
-            if (success < 0)
-            {
-                throw std::system_error(-success, std::system_category(), "Failed to close GPIO line.");
-            }
-            m_fd = -1;
+    auto GpioPin::wait_events(std::chrono::milliseconds timeout) const -> bool
+    {
+        // ... held debounced edges are resolved by read_events() within one period, a glitch that
+        //     settles back makes that read return 0 ...
+        if (m_soft_debounce && has_debounced_events(m_debounce_lines)) {
+            return true;
         }
+        return wait_line_events(m_fd, timeout);
+    }
 
-        if (direction == GpioPin::Direction::In && edge == GpioPin::Edge::None)
-        {
-            struct gpiohandle_request request = {};
+    void GpioPin::open(GpioPin::Direction direction, GpioPin::Edge edge, GpioPin::Bias bias, GpioPin::Drive drive,
+                       GpioPin::Invert invert, GpioPin::EventClock clock, std::chrono::microseconds debounce)
+    {
+        const GpioLines::LineConfig line_config(direction, edge, bias, drive, invert, clock, debounce);
+        uint64_t values = initial_value(direction, invert) ? 1 : 0;
 
-            request.lines = 1;
-            request.lineoffsets[0] = m_line;
-            request.flags = flags;
-            strncpy(request.consumer_label, m_label.c_str(), sizeof(request.consumer_label));
+        struct gpio_v2_line_request request = {};
 
-            auto success = ioctl(m_chip->m_fd, GPIO_GET_LINEHANDLE_IOCTL, &request);
-            if (success < 0)
-            {
-                throw std::system_error(-success, std::system_category(), "Failed to open input line handle.");
-            }
+        request.num_lines = 1;
+        request.offsets[0] = m_line;
+        request.event_buffer_size = m_event_buffer_size;
+        build_line_config(&line_config, 1, values, request.config, true);
+        strncpy(request.consumer, m_label.c_str(), sizeof(request.consumer) - 1);
 
-            m_fd = request.fd;
+        auto success = ioctl(m_chip->m_fd, GPIO_V2_GET_LINE_IOCTL, &request);
+        m_soft_debounce = false;
+        if (success < 0 && has_debounce(&line_config, 1) && debounce_unsupported(errno))
+        {
+            // ... no debounce for this line in the kernel, request it without and filter in read_events() ...
+            request.config = {};
+            build_line_config(&line_config, 1, values, request.config, false);
+            success = ioctl(m_chip->m_fd, GPIO_V2_GET_LINE_IOCTL, &request);
+            m_soft_debounce = true;
         }
-        else if (direction == GpioPin::Direction::In && edge != GpioPin::Edge::None)
+        if (success < 0)
         {
-            struct gpioevent_request request = {};
+            throw std::system_error(errno, std::system_category(), "Failed to open GPIO line.");
+        }
 
-            request.lineoffset = m_line;
-            request.handleflags = flags;
-            request.eventflags = to_request(edge);
-            strncpy(request.consumer_label, m_label.c_str(), sizeof(request.consumer_label) - 1);
+        m_fd = request.fd;
+        m_value = (values & 1) != 0;
+        m_debounce = debounce;
+        m_debounce_lines = setup_debounce(m_fd, &line_config, &m_line, 1, m_soft_debounce);
 
-            auto success = ioctl(m_chip->m_fd, GPIO_GET_LINEEVENT_IOCTL, &request);
-            if (success < 0)
-            {
-                throw std::system_error(-success, std::system_category(), "Failed to open input event line handle.");
-            }
+        m_direction = direction;
+        m_edge = edge;
+        m_bias = bias;
+        m_drive = drive;
+        m_invert = invert;
+        m_clock = clock;
+    }
+
+    void GpioPin::apply(GpioPin::Direction direction, GpioPin::Edge edge, GpioPin::Bias bias, GpioPin::Drive drive,
+                        GpioPin::Invert invert, GpioPin::EventClock clock, std::chrono::microseconds debounce)
+    {
+        // ... the line stays requested, the kernel switches it over in place ...
+        const GpioLines::LineConfig line_config(direction, edge, bias, drive, invert, clock, debounce);
+        const GpioLines::LineConfig current(m_direction, m_edge, m_bias, m_drive, m_invert, m_clock, m_debounce);
+        uint64_t values = keep_levels(m_fd, &current, &line_config, 1, m_value ? 1 : 0);
+
+        struct gpio_v2_line_config config = {};
+        build_line_config(&line_config, 1, values, config, true);
 
-            m_fd = request.fd;
+        auto success = ioctl(m_fd, GPIO_V2_LINE_SET_CONFIG_IOCTL, &config);
+        bool soft_debounce = false;
+        if (success < 0 && has_debounce(&line_config, 1) && debounce_unsupported(errno))
+        {
+            config = {};
+            build_line_config(&line_config, 1, values, config, false);
+            success = ioctl(m_fd, GPIO_V2_LINE_SET_CONFIG_IOCTL, &config);
+            soft_debounce = true;
         }
-        else
+        if (success < 0)
         {
-            struct gpiohandle_request request = {};
-            bool initial_value = (direction == GpioPin::Direction::High);
-            initial_value ^= (invert == GpioPin::Invert::On);
-
-            request.lines = 1;
-            request.lineoffsets[0] = m_line;
-            request.flags = flags;
-            request.default_values[0] = initial_value;
-            strncpy(request.consumer_label, m_label.c_str(), sizeof(request.consumer_label) - 1);
-
-            auto success = ioctl(m_chip->m_fd, GPIO_GET_LINEHANDLE_IOCTL, &request);
-            if (success < 0)
-            {
-                throw std::system_error(EFAULT, std::system_category(), "Failed to open output line handle.");
-            }
-
-            m_fd = request.fd;
+            throw std::system_error(errno, std::system_category(), "Failed to reconfigure GPIO line.");
         }
 
+        m_value = (values & 1) != 0;
+        m_debounce = debounce;
+        m_soft_debounce = soft_debounce;
+        m_debounce_lines = setup_debounce(m_fd, &line_config, &m_line, 1, soft_debounce);
+
         m_direction = direction;
         m_edge = edge;
         m_bias = bias;
         m_drive = drive;
         m_invert = invert;
+        m_clock = clock;
     }
 
     auto GpioPin::direction() const -> GpioPin::Direction { return m_direction; }
@@ -170,7 +221,7 @@ namespace periphery {
     {
         if (m_direction != value)
         {
-            reopen(value, m_edge, m_bias, m_drive, m_invert);
+            apply(value, m_edge, m_bias, m_drive, m_invert, m_clock, m_debounce);
         }
     }
 
@@ -179,7 +230,7 @@ namespace periphery {
     {
         if (m_edge != value)
         {
-            reopen(m_direction, value, m_bias, m_drive, m_invert);
+            apply(m_direction, value, m_bias, m_drive, m_invert, m_clock, m_debounce);
         }
     }
 
@@ -188,7 +239,7 @@ namespace periphery {
     {
         if (m_bias != value)
         {
-            reopen(m_direction, m_edge, value, m_drive, m_invert);
+            apply(m_direction, m_edge, value, m_drive, m_invert, m_clock, m_debounce);
         }
     }
 
@@ -197,7 +248,7 @@ namespace periphery {
     {
         if (m_drive != value)
         {
-            reopen(m_direction, m_edge, m_bias, value, m_invert);
+            apply(m_direction, m_edge, m_bias, value, m_invert, m_clock, m_debounce);
         }
     }
 
@@ -206,22 +257,49 @@ namespace periphery {
     {
         if (m_invert != value)
         {
-            reopen(m_direction, m_edge, m_bias, m_drive, value);
+            apply(m_direction, m_edge, m_bias, m_drive, value, m_clock, m_debounce);
+        }
+    }
+
+    auto GpioPin::clock() const -> GpioPin::EventClock { return m_clock; }
+    void GpioPin::clock(GpioPin::EventClock value)
+    {
+        if (m_clock != value)
+        {
+            apply(m_direction, m_edge, m_bias, m_drive, m_invert, value, m_debounce);
+        }
+    }
+
+    auto GpioPin::debounce() const -> std::chrono::microseconds { return m_debounce; }
+    void GpioPin::debounce(std::chrono::microseconds value)
+    {
+        if (m_debounce != value)
+        {
+            apply(m_direction, m_edge, m_bias, m_drive, m_invert, m_clock, value);
         }
     }
 
     void GpioPin::reconfigure(GpioPin::Direction direction, GpioPin::Edge edge, GpioPin::Bias bias,
                               GpioPin::Drive drive, GpioPin::Invert invert)
     {
-        reopen(direction, edge, bias, drive, invert);
+        apply(direction, edge, bias, drive, invert, m_clock, m_debounce);
+    }
+
+    void GpioPin::reconfigure(GpioPin::Direction direction, GpioPin::Edge edge, GpioPin::Bias bias,
+                              GpioPin::Drive drive, GpioPin::Invert invert, std::chrono::microseconds debounce)
+    {
+        apply(direction, edge, bias, drive, invert, m_clock, debounce);
     }
 
     GpioPin::GpioPin(std::shared_ptr<GpioChip> chip, unsigned int line, const std::string &label,
                      GpioPin::Direction direction, GpioPin::Edge edge, GpioPin::Bias bias, GpioPin::Drive drive,
-                     GpioPin::Invert invert)
-                     : m_chip(chip), m_fd(-1), m_line(line), m_label(label)
+                     GpioPin::Invert invert, GpioPin::EventClock clock, unsigned int event_buffer_size,
+                     std::chrono::microseconds debounce)
+                     : m_chip(chip), m_fd(-1), m_line(line), m_label(label), m_event_buffer_size(event_buffer_size),
+                       m_value(false), m_debounce(0), m_soft_debounce(false), m_last_seqno(0),
+                       m_dropped(0)
     {
-        reopen(direction, edge, bias, drive, invert);
+        open(direction, edge, bias, drive, invert, clock, debounce);
     }
 
     GpioPin::~GpioPin()
@@ -230,71 +308,569 @@ namespace periphery {
     }
 
 
-    auto to_request(GpioPin::Edge edge) -> unsigned long {
-        switch (edge) {
-            case GpioPin::Edge::Rising:  return GPIOEVENT_REQUEST_RISING_EDGE;
-            case GpioPin::Edge::Falling: return GPIOEVENT_REQUEST_FALLING_EDGE;
-            case GpioPin::Edge::Both:    return GPIOEVENT_REQUEST_BOTH_EDGES;
-            case GpioPin::Edge::None:    return 0UL;
+    auto is_output(GpioPin::Direction direction) -> bool {
+        return direction != GpioPin::Direction::In;
+    }
+
+    auto initial_value(GpioPin::Direction direction, GpioPin::Invert invert) -> bool {
+        return (direction == GpioPin::Direction::High) ^ (invert == GpioPin::Invert::On);
+    }
+
+    // ... returns the attribute with the given id and value, adding it when there is none yet, the last
+    //     attribute slot is kept for the output values ...
+    auto find_attr(struct gpio_v2_line_config& config, uint32_t id, uint64_t value) -> struct gpio_v2_line_config_attribute&
+    {
+        for (unsigned int n = 0; n < config.num_attrs; ++n) {
+            auto& attr = config.attrs[n];
+            if (attr.attr.id == id &&
+                (id == GPIO_V2_LINE_ATTR_ID_FLAGS ? attr.attr.flags == value : attr.attr.debounce_period_us == value)) {
+                return attr;
+            }
         }
-        return 0UL;
+        if (config.num_attrs == GPIO_V2_LINE_NUM_ATTRS_MAX - 1) {
+            throw std::invalid_argument("Too many distinct GPIO line configurations.");
+        }
+        auto& attr = config.attrs[config.num_attrs++];
+        attr.attr.id = id;
+        if (id == GPIO_V2_LINE_ATTR_ID_FLAGS) {
+            attr.attr.flags = value;
+        } else {
+            attr.attr.debounce_period_us = static_cast<uint32_t>(value);
+        }
+        return attr;
     }
 
-    auto to_request(GpioPin::Invert invert) -> unsigned long {
-        switch (invert) {
-            case GpioPin::Invert::On:   return GPIOHANDLE_REQUEST_ACTIVE_LOW;
-            case GpioPin::Invert::Off:  return 0UL;
+    void build_line_config(const GpioLines::LineConfig* configs, std::size_t count, uint64_t& values,
+                           struct gpio_v2_line_config& config, bool debounce)
+    {
+        // ... the first line's flags are the default, every other distinct set of flags and every
+        //     distinct debounce period takes one attribute ...
+        config.flags = to_v2_flags(configs[0]);
+
+        uint64_t outputs = 0;
+        for (std::size_t i = 0; i < count; ++i) {
+            const uint64_t bit = 1ULL << i;
+            const uint64_t flags = to_v2_flags(configs[i]);
+
+            if (flags != config.flags) {
+                find_attr(config, GPIO_V2_LINE_ATTR_ID_FLAGS, flags).mask |= bit;
+            }
+
+            // ... debounce only applies to inputs ...
+            if (debounce && !is_output(configs[i].direction) && configs[i].debounce.count() > 0) {
+                find_attr(config, GPIO_V2_LINE_ATTR_ID_DEBOUNCE, configs[i].debounce.count()).mask |= bit;
+            }
+
+            // ... the kernel drives an output to the given value (or low when none is given) every
+            //     time the config is set, Direction::Out keeps the level the line has now ...
+            if (is_output(configs[i].direction)) {
+                outputs |= bit;
+                if (configs[i].direction != GpioPin::Direction::Out) {
+                    values = (values & ~bit) | (initial_value(configs[i].direction, configs[i].invert) ? bit : 0);
+                }
+            }
+        }
+
+        if (outputs != 0) {
+            auto& attr = config.attrs[config.num_attrs++];
+            attr.attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+            attr.attr.values = values & outputs;
+            attr.mask = outputs;
         }
-        return 0UL;
     }
 
-    auto to_request(GpioPin::Direction direction) -> unsigned  long {
-        switch (direction) {
-            case GpioPin::Direction::In:    return GPIOHANDLE_REQUEST_INPUT;
-            case GpioPin::Direction::Out:
-            case GpioPin::Direction::Low:
-            case GpioPin::Direction::High:  return GPIOHANDLE_REQUEST_OUTPUT;
+
+    // ------------------------------------------------------------------------------------------------------------
+    //  GpioLines (GPIO v2 uAPI)
+    // ------------------------------------------------------------------------------------------------------------
+
+    auto has_debounce(const GpioLines::LineConfig* configs, std::size_t count) -> bool
+    {
+        for (std::size_t i = 0; i < count; ++i) {
+            if (!is_output(configs[i].direction) && configs[i].debounce.count() > 0) {
+                return true;
+            }
         }
-        return 0UL;
+        return false;
+    }
+
+    auto to_v2_flags(const GpioLines::LineConfig& config) -> uint64_t {
+        return to_v2_flags(config.direction, config.edge, config.bias, config.drive, config.invert, config.clock);
     }
 
-#ifdef GPIOHANDLE_REQUEST_BIAS_PULL_UP
-    auto to_request(GpioPin::Bias bias) {
+    auto to_v2_flags(GpioPin::Direction direction, GpioPin::Edge edge, GpioPin::Bias bias, GpioPin::Drive drive,
+                     GpioPin::Invert invert, GpioPin::EventClock clock) -> uint64_t {
+        uint64_t flags = is_output(direction) ? GPIO_V2_LINE_FLAG_OUTPUT : GPIO_V2_LINE_FLAG_INPUT;
+
+        switch (edge) {
+            case GpioPin::Edge::Rising:  flags |= GPIO_V2_LINE_FLAG_EDGE_RISING; break;
+            case GpioPin::Edge::Falling: flags |= GPIO_V2_LINE_FLAG_EDGE_FALLING; break;
+            case GpioPin::Edge::Both:    flags |= GPIO_V2_LINE_FLAG_EDGE_RISING | GPIO_V2_LINE_FLAG_EDGE_FALLING; break;
+            case GpioPin::Edge::None:    break;
+        }
+
         switch (bias) {
-            case GpioPin::Bias::PullUp:     return GPIOHANDLE_REQUEST_BIAS_PULL_UP;
-            case GpioPin::Bias::PullDown:   return GPIOHANDLE_REQUEST_BIAS_PULL_DOWN;
-            case GpioPin::Bias::Disable:    return GPIOHANDLE_REQUEST_DISABLE;
-            case GpioPin::Bias::Default:    return 0UL;
+            case GpioPin::Bias::PullUp:   flags |= GPIO_V2_LINE_FLAG_BIAS_PULL_UP; break;
+            case GpioPin::Bias::PullDown: flags |= GPIO_V2_LINE_FLAG_BIAS_PULL_DOWN; break;
+            case GpioPin::Bias::Disable:  flags |= GPIO_V2_LINE_FLAG_BIAS_DISABLED; break;
+            case GpioPin::Bias::Default:  break;
+        }
+
+        switch (drive) {
+            case GpioPin::Drive::OpenDrain:  flags |= GPIO_V2_LINE_FLAG_OPEN_DRAIN; break;
+            case GpioPin::Drive::OpenSource: flags |= GPIO_V2_LINE_FLAG_OPEN_SOURCE; break;
+            case GpioPin::Drive::Default:    break;
+        }
+
+        if (invert == GpioPin::Invert::On) {
+            flags |= GPIO_V2_LINE_FLAG_ACTIVE_LOW;
+        }
+
+        if (clock == GpioPin::EventClock::Realtime) {
+            flags |= GPIO_V2_LINE_FLAG_EVENT_CLOCK_REALTIME;
+        }
+
+        return flags;
+    }
+
+    GpioLines::GpioLines(std::shared_ptr<GpioChip> chip, const std::vector<unsigned int>& lines,
+                         const std::string& label, const LineConfig& config, unsigned int event_buffer_size)
+        : GpioLines(chip, lines, label, std::vector<LineConfig>(lines.size(), config), event_buffer_size)
+    {
+    }
+
+    GpioLines::GpioLines(std::shared_ptr<GpioChip> chip, const std::vector<unsigned int>& lines,
+                         const std::string& label, const std::vector<LineConfig>& configs,
+                         unsigned int event_buffer_size)
+        : m_chip(chip), m_fd(-1), m_all(0), m_lines(lines), m_configs(configs), m_label(label),
+          m_values(0), m_event_buffer_size(event_buffer_size), m_last_seqno(0), m_dropped(0),
+          m_soft_debounce(false)
+    {
+        if (m_lines.empty() || m_lines.size() > max_lines) {
+            throw std::invalid_argument("GPIO line count must be between 1 and 64");
+        }
+        if (m_configs.size() != m_lines.size()) {
+            throw std::invalid_argument("GPIO line configuration count does not match line count");
+        }
+        for (auto line : m_lines) {
+            if (line >= m_chip->m_lines) {
+                throw std::invalid_argument("GPIO line offset out of range");
+            }
         }
-        return 0UL;
+
+        m_all = (m_lines.size() == max_lines) ? ~0ULL : ((1ULL << m_lines.size()) - 1);
+
+        open();
+    }
+
+    GpioLines::~GpioLines()
+    {
+        close(m_fd);
     }
-#else
-    auto to_request(GpioPin::Bias bias) -> unsigned long {
-        if (bias != GpioPin::Bias::Default) {
-            throw std::runtime_error("Kernel version does not support configuring GPIO line bias.");
+
+    void GpioLines::open()
+    {
+        struct gpio_v2_line_request request = {};
+
+        request.num_lines = m_lines.size();
+        request.event_buffer_size = m_event_buffer_size;
+        for (std::size_t i = 0; i < m_lines.size(); ++i) {
+            request.offsets[i] = m_lines[i];
         }
-        return 0UL;
+        strncpy(request.consumer, m_label.c_str(), sizeof(request.consumer) - 1);
+
+        uint64_t values = 0;
+        for (std::size_t i = 0; i < m_configs.size(); ++i) {
+            if (initial_value(m_configs[i].direction, m_configs[i].invert)) {
+                values |= 1ULL << i;
+            }
+        }
+        build_line_config(m_configs.data(), m_configs.size(), values, request.config, true);
+
+        auto success = ioctl(m_chip->m_fd, GPIO_V2_GET_LINE_IOCTL, &request);
+        bool soft_debounce = false;
+        if (success < 0 && has_debounce(m_configs.data(), m_configs.size()) && debounce_unsupported(errno))
+        {
+            // ... no debounce for these lines in the kernel, request them without and filter in read_events() ...
+            request.config = {};
+            build_line_config(m_configs.data(), m_configs.size(), values, request.config, false);
+            success = ioctl(m_chip->m_fd, GPIO_V2_GET_LINE_IOCTL, &request);
+            soft_debounce = true;
+        }
+        if (success < 0)
+        {
+            throw std::system_error(errno, std::system_category(), "Failed to open GPIO lines.");
+        }
+
+        m_fd = request.fd;
+        m_values = values;
+        set_soft_debounce(soft_debounce);
     }
-#endif
 
-#ifdef GPIOHANDLE_REQUEST_OPEN_DRAIN
-    auto to_request(GpioPin::Drive drive) -> unsigned long {
-        switch (drive) {
-            case GpioPin::Drive::OpenSource:  return GPIOHANDLE_REQUEST_OPEN_SOURCE;
-            case GpioPin::Drive::OpenDrain:   return GPIOHANDLE_REQUEST_OPEN_DRAIN;
-            case GpioPin::Drive::Default:     return 0UL;
+    void GpioLines::set_soft_debounce(bool enable)
+    {
+        m_soft_debounce = enable;
+        m_debounce_lines = setup_debounce(m_fd, m_configs.data(), m_lines.data(), m_lines.size(), enable);
+    }
+
+    void GpioLines::reconfigure(std::size_t index, const LineConfig& config)
+    {
+        auto configs = m_configs;
+        configs.at(index) = config;
+        reconfigure(configs);
+    }
+
+    void GpioLines::reconfigure(const std::vector<LineConfig>& configs)
+    {
+        if (configs.size() != m_lines.size()) {
+            throw std::invalid_argument("GPIO line configuration count does not match line count");
+        }
+
+        // ... the lines stay requested, the kernel switches them over in place ...
+        uint64_t values = keep_levels(m_fd, m_configs.data(), configs.data(), configs.size(), m_values);
+        struct gpio_v2_line_config config = {};
+        build_line_config(configs.data(), configs.size(), values, config, true);
+
+        auto success = ioctl(m_fd, GPIO_V2_LINE_SET_CONFIG_IOCTL, &config);
+        bool soft_debounce = false;
+        if (success < 0 && has_debounce(configs.data(), configs.size()) && debounce_unsupported(errno))
+        {
+            config = {};
+            build_line_config(configs.data(), configs.size(), values, config, false);
+            success = ioctl(m_fd, GPIO_V2_LINE_SET_CONFIG_IOCTL, &config);
+            soft_debounce = true;
+        }
+        if (success < 0)
+        {
+            throw std::system_error(errno, std::system_category(), "Failed to reconfigure GPIO lines.");
+        }
+
+        m_configs = configs;
+        m_values = values;
+        set_soft_debounce(soft_debounce);
+    }
+
+    auto GpioLines::get_values(uint64_t mask) const -> uint64_t
+    {
+        struct gpio_v2_line_values values = {};
+        values.mask = mask & m_all;
+
+        auto success = ioctl(m_fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &values);
+        if (success < 0)
+        {
+            throw std::system_error(errno, std::system_category(), "Failed to read GPIO line values.");
+        }
+
+        return values.bits & values.mask;
+    }
+
+    void GpioLines::set_values(uint64_t mask, uint64_t bits)
+    {
+        struct gpio_v2_line_values values = {};
+        values.mask = mask & m_all;
+        values.bits = bits;
+
+        if (values.mask == 0) {
+            return;
         }
-        return 0UL;
+
+        auto success = ioctl(m_fd, GPIO_V2_LINE_SET_VALUES_IOCTL, &values);
+        if (success < 0)
+        {
+            throw std::system_error(errno, std::system_category(), "Failed to write GPIO line values.");
+        }
+
+        m_values = (m_values & ~values.mask) | (bits & values.mask);
     }
-#else
-    auto to_request(GpioPin::Drive drive) -> unsigned long {
-        if (drive != GpioPin::Drive::Default) {
-            throw std::runtime_error("Kernel version does not support configuring GPIO line drive.");
+
+    auto GpioLines::read_events(GpioLines::Event* events, std::size_t count) -> std::size_t
+    {
+        if (m_soft_debounce) {
+            return read_debounced_events(m_fd, events, count, m_debounce_lines, m_last_seqno, m_dropped);
         }
-        return 0UL;
+        return read_line_events(m_fd, events, count, m_last_seqno, m_dropped);
     }
-#endif
 
+    auto GpioLines::wait_events(std::chrono::milliseconds timeout) const -> bool
+    {
+        if (m_soft_debounce && has_debounced_events(m_debounce_lines)) {
+            return true;
+        }
+        return wait_line_events(m_fd, timeout);
+    }
+
+
+    // ------------------------------------------------------------------------------------------------------------
+    //  Edge events (shared by GpioPin and GpioLines)
+    // ------------------------------------------------------------------------------------------------------------
+
+    auto read_line_events(int fd, GpioPin::Event* events, std::size_t count,
+                          uint32_t& last_seqno, uint64_t& dropped) -> std::size_t
+    {
+        if (count == 0) {
+            return 0;
+        }
+
+        // ... the kernel copies out as many whole events as are queued and fit, blocking only
+        //     while the queue is empty ...
+        ssize_t ret = ::read(fd, events, count * sizeof(GpioPin::Event));
+        if (ret < 0) {
+            throw std::system_error(errno, std::system_category(), "Failed to read GPIO line events.");
+        }
+        std::size_t n = static_cast<std::size_t>(ret) / sizeof(GpioPin::Event);
+
+        // ... seqno is assigned before an event is queued, so a gap means the kernel dropped events
+        //     because the event buffer overflowed ...
+        for (std::size_t i = 0; i < n; ++i) {
+            dropped += events[i].seqno - last_seqno - 1;
+            last_seqno = events[i].seqno;
+        }
+
+        return n;
+    }
+
+    // ... output values for lines that are or become Direction::Out so that the pin keeps its physical
+    //     level: an input is sampled before it is switched over, a change of inversion flips the value ...
+    auto keep_levels(int fd, const GpioLines::LineConfig* from, const GpioLines::LineConfig* to, std::size_t count,
+                     uint64_t values) -> uint64_t
+    {
+        struct gpio_v2_line_values sample = {};
+        for (std::size_t i = 0; i < count; ++i) {
+            if (to[i].direction == GpioPin::Direction::Out && !is_output(from[i].direction)) {
+                sample.mask |= 1ULL << i;
+            }
+        }
+        if (sample.mask != 0) {
+            if (ioctl(fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &sample) < 0) {
+                throw std::system_error(errno, std::system_category(), "Failed to read GPIO line values.");
+            }
+            values = (values & ~sample.mask) | (sample.bits & sample.mask);
+        }
+
+        for (std::size_t i = 0; i < count; ++i) {
+            if (to[i].direction == GpioPin::Direction::Out && from[i].invert != to[i].invert) {
+                values ^= 1ULL << i;
+            }
+        }
+        return values;
+    }
+
+    // ... only a kernel without debounce support for the line falls back to userspace, anything else
+    //     (busy, permissions, ...) is a real error ...
+    auto debounce_unsupported(int error) -> bool
+    {
+        return error == EINVAL || error == EOPNOTSUPP;
+    }
+
+    auto setup_debounce(int fd, const GpioLines::LineConfig* configs, const unsigned int* lines, std::size_t count,
+                        bool enable) -> std::vector<GpioDebounceLine>
+    {
+        std::vector<GpioDebounceLine> state;
+        if (!enable) {
+            return state;
+        }
+
+        state.resize(count, GpioDebounceLine());
+        uint64_t mask = 0;
+        for (std::size_t i = 0; i < count; ++i) {
+            state[i].offset = lines[i];
+            state[i].level = -1;
+            if (!is_output(configs[i].direction) && configs[i].debounce.count() > 0) {
+                state[i].period_us = static_cast<uint32_t>(configs[i].debounce.count());
+                state[i].rising = configs[i].edge == GpioPin::Edge::Rising || configs[i].edge == GpioPin::Edge::Both;
+                state[i].falling = configs[i].edge == GpioPin::Edge::Falling || configs[i].edge == GpioPin::Edge::Both;
+                mask |= 1ULL << i;
+            }
+        }
+
+        // ... the settled level starts out as the current level ...
+        struct gpio_v2_line_values values = {};
+        values.mask = mask;
+        if (mask != 0 && ioctl(fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &values) == 0) {
+            for (std::size_t i = 0; i < count; ++i) {
+                if (mask & (1ULL << i)) {
+                    state[i].level = (values.bits >> i) & 1 ? 1 : 0;
+                }
+            }
+        }
+        return state;
+    }
+
+    auto has_debounced_events(const std::vector<GpioDebounceLine>& lines) -> bool
+    {
+        for (const auto& line : lines) {
+            if (line.pending || line.ready) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // ... edges of debounced lines are absorbed into the pending state of their line, the other
+    //     events are compacted to the front, returns how many are left ...
+    static auto absorb_events(GpioPin::Event* events, std::size_t count, std::vector<GpioDebounceLine>& lines) -> std::size_t
+    {
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < count; ++i) {
+            GpioDebounceLine* line = nullptr;
+            for (auto& l : lines) {
+                if (l.offset == events[i].offset && l.period_us != 0) {
+                    line = &l;
+                }
+            }
+            if (line == nullptr) {
+                events[kept++] = events[i];
+                continue;
+            }
+            line->pending = true;
+            line->pending_ns = events[i].timestamp_ns;
+            line->pending_seqno = events[i].seqno;
+            line->pending_line_seqno = events[i].line_seqno;
+        }
+        return kept;
+    }
+
+    // ... longest period of the lines with held edges, 0 when none ...
+    static auto pending_period(const std::vector<GpioDebounceLine>& lines) -> uint32_t
+    {
+        uint32_t period = 0;
+        for (const auto& line : lines) {
+            if (line.pending && line.period_us > period) {
+                period = line.period_us;
+            }
+        }
+        return period;
+    }
+
+    // ... the held lines have been quiet long enough, read where they settled ...
+    static void settle_lines(int fd, std::vector<GpioDebounceLine>& lines)
+    {
+        struct gpio_v2_line_values values = {};
+        for (std::size_t i = 0; i < lines.size(); ++i) {
+            if (lines[i].pending) {
+                values.mask |= 1ULL << i;
+            }
+        }
+        if (ioctl(fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &values) < 0) {
+            throw std::system_error(errno, std::system_category(), "Failed to read GPIO line values.");
+        }
+
+        for (std::size_t i = 0; i < lines.size(); ++i) {
+            GpioDebounceLine& line = lines[i];
+            if (!line.pending) {
+                continue;
+            }
+            line.pending = false;
+
+            // ... a glitch that ends where it started is not reported, nor an edge that was not requested ...
+            int level = (values.bits >> i) & 1 ? 1 : 0;
+            if (level == line.level) {
+                continue;
+            }
+            line.level = level;
+            if (level ? line.rising : line.falling) {
+                line.ready = true;
+                line.ready_ns = line.pending_ns;
+                line.ready_seqno = line.pending_seqno;
+                line.ready_line_seqno = line.pending_line_seqno;
+            }
+        }
+    }
+
+    static auto take_ready(GpioPin::Event* events, std::size_t count, std::vector<GpioDebounceLine>& lines) -> std::size_t
+    {
+        std::size_t n = 0;
+        for (auto& line : lines) {
+            if (n == count) {
+                break;
+            }
+            if (!line.ready) {
+                continue;
+            }
+            GpioPin::Event event = {};
+            event.timestamp_ns = line.ready_ns;
+            event.id = line.level ? GPIO_V2_LINE_EVENT_RISING_EDGE : GPIO_V2_LINE_EVENT_FALLING_EDGE;
+            event.offset = line.offset;
+            event.seqno = line.ready_seqno;
+            event.line_seqno = line.ready_line_seqno;
+            events[n++] = event;
+            line.ready = false;
+        }
+        return n;
+    }
+
+    static auto wait_line_events_us(int fd, uint32_t timeout_us) -> bool
+    {
+        struct pollfd fds[1];
+        fds[0].fd = fd;
+        fds[0].events = POLLIN | POLLPRI;
+
+        struct timespec ts;
+        ts.tv_sec = timeout_us / 1000000;
+        ts.tv_nsec = static_cast<long>(timeout_us % 1000000) * 1000;
+        int ret = ::ppoll(fds, 1, &ts, nullptr);
+        if (ret < 0) {
+            throw std::system_error(errno, std::system_category(), "Failed to wait for GPIO line events.");
+        }
+        return (ret > 0);
+    }
+
+    // ... userspace debounce: every edge of a debounced line restarts its quiet period, once no edge
+    //     arrived for the period the line value is read and an event for the settled level is
+    //     reported if it differs from the previous settled level, timestamped with the last edge.
+    //     Unlike kernel debounce every bounce still wakes the process. Blocks until at least one
+    //     event can be reported, except when the call started with held edges (wait_events() said
+    //     there was something to read) and they settled back to the previous level, then it returns
+    //     0 instead of blocking for the next edge ...
+    auto read_debounced_events(int fd, GpioPin::Event* events, std::size_t count, std::vector<GpioDebounceLine>& lines,
+                               uint32_t& last_seqno, uint64_t& dropped) -> std::size_t
+    {
+        if (count == 0) {
+            return 0;
+        }
+
+        std::size_t n = take_ready(events, count, lines);
+        const bool held = pending_period(lines) != 0;
+        for (;;) {
+            uint32_t quiet_us = pending_period(lines);
+            if (quiet_us == 0 && n > 0) {
+                return n;
+            }
+            if (quiet_us != 0) {
+                // ... no room to read more, the held edges are resolved by the next call ...
+                if (n == count) {
+                    return n;
+                }
+                if (!wait_line_events_us(fd, quiet_us)) {
+                    settle_lines(fd, lines);
+                    n += take_ready(events + n, count - n, lines);
+                    if (n == 0 && held) {
+                        return 0;
+                    }
+                    continue;
+                }
+            }
+
+            // ... blocks only when nothing is held ...
+            std::size_t got = read_line_events(fd, events + n, count - n, last_seqno, dropped);
+            n += absorb_events(events + n, got, lines);
+        }
+    }
+
+    auto wait_line_events(int fd, std::chrono::milliseconds timeout) -> bool
+    {
+        struct pollfd fds[1];
+
+        fds[0].fd = fd;
+        fds[0].events = POLLIN | POLLPRI;
+        int ret = ::poll(fds, 1, timeout.count());
+
+        // ... ret < 0 is an error, ret > 0 is success, ret == 0 is timeout ...
+        if (ret < 0) {
+            throw std::system_error(errno, std::system_category(), "Failed to wait for GPIO line events.");
+        }
+        return (ret > 0);
+    }
 
 
 
@@ -0,0 +1,79 @@
+/*!
+ * \package         cpp-periphery
+ * \file            gpio_mmio.cpp
+ * \author          Mark Butowski (github.com/mpb27)
+ * \date            2020-10-13
+ * \license         MIT
+ *
+ * <a href="GitHub"> https://github.com/mpb27/cpp-periphery </a>
+ */
+
+// C++11 headers:
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#include "periphery/gpio_mmio.hpp"
+
+namespace periphery {
+
+    GpioMmioPin::GpioMmioPin(std::shared_ptr<GpioChip> chip, unsigned int line, const std::string& label,
+                             std::shared_ptr<Mmio> bank, const GpioBankLayout& layout, unsigned int bit,
+                             GpioPin::Direction direction, GpioPin::Bias bias, GpioPin::Drive drive,
+                             GpioPin::Invert invert)
+        // ... the kernel only sees physical levels, inversion is done here on the register value,
+        //     Direction::Low / High already are physical levels (see GpioPin::Direction) ...
+        : m_pin(chip, line, label, direction, GpioPin::Edge::None, bias, drive, GpioPin::Invert::Off),
+          m_bank(bank), m_layout(layout), m_mask(0), m_invert(invert),
+          m_data(nullptr), m_set(nullptr), m_clear(nullptr)
+    {
+        if (m_layout.width != 8 && m_layout.width != 16 && m_layout.width != 32) {
+            throw std::invalid_argument("GPIO bank width must be 8, 16 or 32 bits");
+        }
+        if (bit >= m_layout.width) {
+            throw std::invalid_argument("GPIO bank bit out of range");
+        }
+        if ((m_layout.set == GpioBankLayout::none) != (m_layout.clear == GpioBankLayout::none)) {
+            throw std::invalid_argument("GPIO bank needs both set and clear registers or neither");
+        }
+
+        // ... validate every register once, the accessors are unchecked ...
+        const std::size_t bytes = m_layout.width / 8;
+        const std::size_t offsets[] = { m_layout.data, m_layout.direction, m_layout.set, m_layout.clear };
+        for (auto offset : offsets) {
+            if (offset != GpioBankLayout::none && (offset % bytes != 0 || offset + bytes > m_bank->size())) {
+                throw std::invalid_argument("GPIO bank register offset out of bounds or misaligned");
+            }
+        }
+
+        auto base = static_cast<uint8_t*>(m_bank->ptr());
+        m_mask = 1U << bit;
+        m_data = base + m_layout.data;
+        if (m_layout.set != GpioBankLayout::none) {
+            m_set = base + m_layout.set;
+            m_clear = base + m_layout.clear;
+        }
+
+        check_direction();
+    }
+
+    void GpioMmioPin::direction(GpioPin::Direction value)
+    {
+        m_pin.direction(value);
+        check_direction();
+    }
+
+    void GpioMmioPin::check_direction() const
+    {
+        if (m_layout.direction == GpioBankLayout::none) {
+            return;
+        }
+
+        // ... a wrong bank, bit or layout shows up as a direction bit that disagrees with the kernel ...
+        auto dir = load(static_cast<const uint8_t*>(m_bank->ptr()) + m_layout.direction);
+        bool out = ((dir & m_mask) != 0) == m_layout.direction_out_is_one;
+        if (out != (m_pin.direction() != GpioPin::Direction::In)) {
+            throw std::invalid_argument("GPIO bank layout does not match the line's direction");
+        }
+    }
+}
@@ -6,11 +6,14 @@
  */
 
 
+#include <array>
+#include <cerrno>
+#include <cstddef>
 #include <cstdlib>
 #include <cstdint>
 #include <cstring>
+#include <stdexcept>
 #include <system_error>
-#include <memory>
 
 #include <unistd.h>
 #include <fcntl.h>
@@ -24,11 +27,14 @@
 
 namespace periphery {
 
+static_assert(I2C::max_messages == I2C_RDWR_IOCTL_MAX_MSGS, "I2C::max_messages mismatch");
+static_assert(I2C::smbus_block_max == I2C_SMBUS_BLOCK_MAX, "I2C::smbus_block_max mismatch");
+
 //class ReadMessage : public I2C::Message {};
 //class WriteMessage : public I2C::Message {};
 
 I2C::I2C(const std::string& path)
-    : m_path(path)
+    : m_path(path), m_funcs(0), m_pec(false), m_selected(-1)
 {
     // ... open device ...
     m_fd = open(path.c_str(), O_RDWR);
@@ -44,11 +50,12 @@ I2C::I2C(const std::string& path)
         throw e;
     }
 
-    // ... check that this device has I2C function ...
-    if (!(supported_funcs & I2C_FUNC_I2C)) {
+    // ... check that this device has I2C function, or is at least an SMBus controller ...
+    if (!(supported_funcs & (I2C_FUNC_I2C | I2C_FUNC_SMBUS_EMUL_ALL))) {
         close(m_fd);
         throw std::runtime_error("I2C not supported on ???");
     }
+    m_funcs = supported_funcs;
 }
 
 
@@ -103,9 +110,13 @@ void I2C::transfer(uint16_t addr, std::vector<std::reference_wrapper<Message>>&
 template <typename ForwardIt>
 void I2C::transfer_impl(uint16_t addr, ForwardIt first, ForwardIt last) const
 {
-    // ... create i2c_msg structure needed by linux call ...
+    // ... create i2c_msg structure needed by linux call, on the stack, the kernel rejects more
+    //     than I2C_RDWR_IOCTL_MAX_MSGS anyway ...
     unsigned int count = last - first;
-    std::unique_ptr<i2c_msg[]> p(new i2c_msg[count]);
+    if (count > I2C_RDWR_IOCTL_MAX_MSGS) {
+        throw std::invalid_argument("too many I2C messages in one transfer");
+    }
+    std::array<i2c_msg, I2C_RDWR_IOCTL_MAX_MSGS> p;
     for (size_t i = 0 ; i < count; ++i) {
         auto& m = (Message&) *first++;
         p[i].addr  = addr;
@@ -115,7 +126,7 @@ void I2C::transfer_impl(uint16_t addr, ForwardIt first, ForwardIt last) const
     }
 
     // ... create transfer descriptor ...
-    i2c_rdwr_ioctl_data i2c_rdwr_data { p.get(), count };
+    i2c_rdwr_ioctl_data i2c_rdwr_data { p.data(), count };
 
     int error = ioctl(m_fd, I2C_RDWR, &i2c_rdwr_data);
     if (error < 0) {
@@ -124,6 +135,304 @@ void I2C::transfer_impl(uint16_t addr, ForwardIt first, ForwardIt last) const
 }
 
 
+void I2C::transfer(const BufferMessage* messages, std::size_t count) const
+{
+    // ... BufferMessage arrays are passed to I2C_RDWR as they are ...
+    static_assert(sizeof(BufferMessage) == sizeof(struct i2c_msg), "I2C::BufferMessage size mismatch");
+    static_assert(offsetof(BufferMessage, m_flags) == offsetof(struct i2c_msg, flags), "I2C::BufferMessage layout mismatch");
+    static_assert(offsetof(BufferMessage, m_len) == offsetof(struct i2c_msg, len), "I2C::BufferMessage layout mismatch");
+    static_assert(offsetof(BufferMessage, m_buf) == offsetof(struct i2c_msg, buf), "I2C::BufferMessage layout mismatch");
+    static_assert(BufferMessage::flag_read == I2C_M_RD, "I2C::BufferMessage read flag mismatch");
+
+    if (count > I2C_RDWR_IOCTL_MAX_MSGS) {
+        throw std::invalid_argument("too many I2C messages in one transfer");
+    }
+
+    // ... the kernel only reads the message array, it copies the data back through buf ...
+    i2c_rdwr_ioctl_data i2c_rdwr_data {
+        reinterpret_cast<i2c_msg*>(const_cast<BufferMessage*>(messages)),
+        static_cast<__u32>(count)
+    };
+
+    int error = ioctl(m_fd, I2C_RDWR, &i2c_rdwr_data);
+    if (error < 0) {
+        throw std::system_error(errno, std::system_category());
+    }
+}
+
+
+void I2C::transfer(uint16_t addr, std::initializer_list<BufferMessage> messages) const
+{
+    if (messages.size() > I2C_RDWR_IOCTL_MAX_MSGS) {
+        throw std::invalid_argument("too many I2C messages in one transfer");
+    }
+
+    std::array<BufferMessage, I2C_RDWR_IOCTL_MAX_MSGS> p;
+    std::size_t count = 0;
+    for (const auto& m : messages) {
+        p[count] = m;
+        p[count].m_addr = addr;
+        ++count;
+    }
+
+    transfer(p.data(), count);
+}
+
+
+// ... SMBus ...
+
+namespace {
+
+void smbus_access(int fd, uint8_t read_write, uint8_t command, uint32_t size, i2c_smbus_data* data)
+{
+    i2c_smbus_ioctl_data args { read_write, command, size, data };
+
+    int error = ioctl(fd, I2C_SMBUS, &args);
+    if (error < 0) {
+        throw std::system_error(errno, std::system_category());
+    }
+}
+
+}
+
+
+void I2C::select(uint16_t addr) const
+{
+    if (m_selected == addr) {
+        return;
+    }
+
+    int error = ioctl(m_fd, I2C_SLAVE, static_cast<unsigned long>(addr));
+    if (error < 0) {
+        m_selected = -1;
+        throw std::system_error(errno, std::system_category());
+    }
+    m_selected = addr;
+}
+
+
+bool I2C::use_smbus(uint16_t addr, unsigned long func) const
+{
+    if (!(m_funcs & func)) {
+        if (!(m_funcs & I2C_FUNC_I2C)) {
+            throw std::runtime_error("SMBus transfer not supported by " + m_path);
+        }
+        return false;
+    }
+
+    // ... PEC only exists on the SMBus path, SMBus only adapters have no other path, otherwise
+    //     SMBus is only cheaper when it does not need an extra I2C_SLAVE ioctl ...
+    return m_pec || !(m_funcs & I2C_FUNC_I2C) || m_selected == addr;
+}
+
+
+void I2C::pec(bool enable)
+{
+    if (enable && !(m_funcs & I2C_FUNC_SMBUS_PEC)) {
+        throw std::runtime_error("SMBus PEC not supported by " + m_path);
+    }
+
+    int error = ioctl(m_fd, I2C_PEC, enable ? 1UL : 0UL);
+    if (error < 0) {
+        throw std::system_error(errno, std::system_category());
+    }
+    m_pec = enable;
+}
+
+
+void I2C::smbus_quick(uint16_t addr, bool read) const
+{
+    select(addr);
+    smbus_access(m_fd, read ? I2C_SMBUS_READ : I2C_SMBUS_WRITE, 0, I2C_SMBUS_QUICK, nullptr);
+}
+
+
+uint8_t I2C::smbus_read_byte(uint16_t addr) const
+{
+    i2c_smbus_data data;
+    select(addr);
+    smbus_access(m_fd, I2C_SMBUS_READ, 0, I2C_SMBUS_BYTE, &data);
+    return data.byte;
+}
+
+
+void I2C::smbus_write_byte(uint16_t addr, uint8_t value) const
+{
+    select(addr);
+    smbus_access(m_fd, I2C_SMBUS_WRITE, value, I2C_SMBUS_BYTE, nullptr);
+}
+
+
+uint8_t I2C::smbus_read_byte_data(uint16_t addr, uint8_t command) const
+{
+    i2c_smbus_data data;
+    select(addr);
+    smbus_access(m_fd, I2C_SMBUS_READ, command, I2C_SMBUS_BYTE_DATA, &data);
+    return data.byte;
+}
+
+
+void I2C::smbus_write_byte_data(uint16_t addr, uint8_t command, uint8_t value) const
+{
+    i2c_smbus_data data;
+    data.byte = value;
+    select(addr);
+    smbus_access(m_fd, I2C_SMBUS_WRITE, command, I2C_SMBUS_BYTE_DATA, &data);
+}
+
+
+uint16_t I2C::smbus_read_word_data(uint16_t addr, uint8_t command) const
+{
+    i2c_smbus_data data;
+    select(addr);
+    smbus_access(m_fd, I2C_SMBUS_READ, command, I2C_SMBUS_WORD_DATA, &data);
+    return data.word;
+}
+
+
+void I2C::smbus_write_word_data(uint16_t addr, uint8_t command, uint16_t value) const
+{
+    i2c_smbus_data data;
+    data.word = value;
+    select(addr);
+    smbus_access(m_fd, I2C_SMBUS_WRITE, command, I2C_SMBUS_WORD_DATA, &data);
+}
+
+
+uint16_t I2C::smbus_process_call(uint16_t addr, uint8_t command, uint16_t value) const
+{
+    i2c_smbus_data data;
+    data.word = value;
+    select(addr);
+    smbus_access(m_fd, I2C_SMBUS_WRITE, command, I2C_SMBUS_PROC_CALL, &data);
+    return data.word;
+}
+
+
+std::size_t I2C::smbus_read_block_data(uint16_t addr, uint8_t command, mutable_buffer rx) const
+{
+    i2c_smbus_data data;
+    select(addr);
+    smbus_access(m_fd, I2C_SMBUS_READ, command, I2C_SMBUS_BLOCK_DATA, &data);
+
+    // ... the device decides the length, block[0] ...
+    std::size_t len = data.block[0];
+    if (len > rx.size()) {
+        throw std::length_error("SMBus block larger than receive buffer");
+    }
+    memcpy(rx.data(), &data.block[1], len);
+    return len;
+}
+
+
+void I2C::smbus_write_block_data(uint16_t addr, uint8_t command, const_buffer tx) const
+{
+    if (tx.size() > I2C_SMBUS_BLOCK_MAX) {
+        throw std::invalid_argument("SMBus block longer than 32 bytes");
+    }
+
+    i2c_smbus_data data;
+    data.block[0] = static_cast<uint8_t>(tx.size());
+    memcpy(&data.block[1], tx.data(), tx.size());
+    select(addr);
+    smbus_access(m_fd, I2C_SMBUS_WRITE, command, I2C_SMBUS_BLOCK_DATA, &data);
+}
+
+
+void I2C::smbus_read_i2c_block_data(uint16_t addr, uint8_t command, mutable_buffer rx) const
+{
+    if (rx.size() > I2C_SMBUS_BLOCK_MAX) {
+        throw std::invalid_argument("SMBus block longer than 32 bytes");
+    }
+
+    i2c_smbus_data data;
+    data.block[0] = static_cast<uint8_t>(rx.size());
+    select(addr);
+    smbus_access(m_fd, I2C_SMBUS_READ, command, I2C_SMBUS_I2C_BLOCK_DATA, &data);
+    memcpy(rx.data(), &data.block[1], rx.size());
+}
+
+
+void I2C::smbus_write_i2c_block_data(uint16_t addr, uint8_t command, const_buffer tx) const
+{
+    if (tx.size() > I2C_SMBUS_BLOCK_MAX) {
+        throw std::invalid_argument("SMBus block longer than 32 bytes");
+    }
+
+    i2c_smbus_data data;
+    data.block[0] = static_cast<uint8_t>(tx.size());
+    memcpy(&data.block[1], tx.data(), tx.size());
+    select(addr);
+    smbus_access(m_fd, I2C_SMBUS_WRITE, command, I2C_SMBUS_I2C_BLOCK_DATA, &data);
+}
+
+
+// ... registers ...
+
+uint8_t I2C::read_reg8(uint16_t addr, uint8_t reg) const
+{
+    if (use_smbus(addr, I2C_FUNC_SMBUS_READ_BYTE_DATA)) {
+        return smbus_read_byte_data(addr, reg);
+    }
+
+    uint8_t value = 0;
+    const BufferMessage messages[] = {
+        BufferMessage::write(addr, buffer(&reg, 1)),
+        BufferMessage::read(addr, buffer(&value, 1))
+    };
+    transfer(messages, 2);
+    return value;
+}
+
+
+void I2C::write_reg8(uint16_t addr, uint8_t reg, uint8_t value) const
+{
+    if (use_smbus(addr, I2C_FUNC_SMBUS_WRITE_BYTE_DATA)) {
+        smbus_write_byte_data(addr, reg, value);
+        return;
+    }
+
+    const uint8_t tx[2] = { reg, value };
+    const BufferMessage message = BufferMessage::write(addr, buffer(tx));
+    transfer(&message, 1);
+}
+
+
+uint16_t I2C::read_reg16(uint16_t addr, uint8_t reg, ByteOrder order) const
+{
+    uint16_t value;
+    if (use_smbus(addr, I2C_FUNC_SMBUS_READ_WORD_DATA)) {
+        value = smbus_read_word_data(addr, reg);
+        return order == ByteOrder::LittleEndian ? value : static_cast<uint16_t>((value << 8) | (value >> 8));
+    }
+
+    uint8_t rx[2] = {};
+    const BufferMessage messages[] = {
+        BufferMessage::write(addr, buffer(&reg, 1)),
+        BufferMessage::read(addr, buffer(rx))
+    };
+    transfer(messages, 2);
+    return order == ByteOrder::LittleEndian ? static_cast<uint16_t>(rx[0] | (rx[1] << 8))
+                                            : static_cast<uint16_t>((rx[0] << 8) | rx[1]);
+}
+
+
+void I2C::write_reg16(uint16_t addr, uint8_t reg, uint16_t value, ByteOrder order) const
+{
+    if (use_smbus(addr, I2C_FUNC_SMBUS_WRITE_WORD_DATA)) {
+        smbus_write_word_data(addr, reg,
+            order == ByteOrder::LittleEndian ? value : static_cast<uint16_t>((value << 8) | (value >> 8)));
+        return;
+    }
+
+    const uint8_t lo = static_cast<uint8_t>(value);
+    const uint8_t hi = static_cast<uint8_t>(value >> 8);
+    const uint8_t tx[3] = { reg, order == ByteOrder::LittleEndian ? lo : hi, order == ByteOrder::LittleEndian ? hi : lo };
+    const BufferMessage message = BufferMessage::write(addr, buffer(tx));
+    transfer(&message, 1);
+}
+
+
 std::string I2C::toString() const
 {
     return "I2C (" + m_path + ")";
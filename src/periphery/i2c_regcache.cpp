@@ -0,0 +1,179 @@
+/*
+ * cpp-periphery
+ * https://github.com/mpb27/cpp-periphery
+ * License: MIT
+ *
+ */
+
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#include "periphery/i2c_regcache.hpp"
+
+namespace periphery {
+
+
+I2CRegisterCache::I2CRegisterCache(std::shared_ptr<I2C> i2c, uint16_t addr, std::size_t num_registers, Mode mode,
+                                   std::initializer_list<uint8_t> volatile_registers, std::size_t max_burst)
+    : m_i2c(i2c), m_addr(addr), m_size(num_registers), m_mode(mode), m_max_burst(max_burst), m_values()
+{
+    if (m_size == 0 || m_size > 256) {
+        throw std::invalid_argument("register count must be between 1 and 256");
+    }
+    if (m_max_burst == 0 || m_max_burst > 0xFFFE) {
+        throw std::invalid_argument("burst length out of range");
+    }
+
+    for (auto reg : volatile_registers) {
+        check(reg);
+        m_volatile.set(reg);
+    }
+
+    // ... worst case every other register is dirty, one address byte per register ...
+    m_tx.resize(2 * m_size);
+}
+
+
+void I2CRegisterCache::check(uint8_t reg) const
+{
+    if (reg >= m_size) {
+        throw std::invalid_argument("register out of range");
+    }
+}
+
+
+uint8_t I2CRegisterCache::read(uint8_t reg)
+{
+    check(reg);
+
+    if (m_volatile[reg]) {
+        return m_i2c->read_reg8(m_addr, reg);
+    }
+
+    if (!m_valid[reg]) {
+        m_values[reg] = m_i2c->read_reg8(m_addr, reg);
+        m_valid.set(reg);
+    }
+    return m_values[reg];
+}
+
+
+void I2CRegisterCache::write(uint8_t reg, uint8_t value)
+{
+    check(reg);
+
+    if (m_volatile[reg]) {
+        m_i2c->write_reg8(m_addr, reg, value);
+        return;
+    }
+
+    if (m_mode == Mode::WriteThrough) {
+        write_now(reg, value);
+    } else {
+        m_values[reg] = value;
+        m_valid.set(reg);
+        m_dirty.set(reg);
+    }
+}
+
+
+void I2CRegisterCache::update_bits(uint8_t reg, uint8_t mask, uint8_t value)
+{
+    uint8_t old_value = read(reg);
+    uint8_t new_value = (old_value & ~mask) | (value & mask);
+
+    if (new_value != old_value || m_volatile[reg]) {
+        write(reg, new_value);
+    }
+}
+
+
+void I2CRegisterCache::write_now(uint8_t reg, uint8_t value)
+{
+    m_i2c->write_reg8(m_addr, reg, value);
+    m_values[reg] = value;
+    m_valid.set(reg);
+    m_dirty.reset(reg);
+}
+
+
+void I2CRegisterCache::sync()
+{
+    std::size_t reg = 0;
+    while (m_dirty.any()) {
+        // ... gather up to 42 bursts, each one [register, values...] in the staging buffer ...
+        I2C::Transaction<I2C::max_messages> transaction;
+        std::bitset<256> flushed;
+        std::size_t used = 0;
+
+        for (; reg < m_size && transaction.size() < I2C::max_messages; ++reg) {
+            if (!m_dirty[reg]) {
+                continue;
+            }
+
+            std::size_t first = reg;
+            std::size_t start = used;
+            m_tx[used++] = static_cast<uint8_t>(first);
+            while (reg < m_size && m_dirty[reg] && reg - first < m_max_burst) {
+                m_tx[used++] = m_values[reg];
+                flushed.set(reg);
+                ++reg;
+            }
+            transaction.write(m_addr, buffer(&m_tx[start], used - start));
+            --reg;
+        }
+
+        if (transaction.size() == 0) {
+            break;
+        }
+        m_i2c->transfer(transaction);
+
+        m_dirty &= ~flushed;
+    }
+}
+
+
+void I2CRegisterCache::fill(uint8_t first, std::size_t count)
+{
+    if (count == 0) {
+        return;
+    }
+    if (first + count > m_size) {
+        throw std::invalid_argument("register range out of range");
+    }
+
+    // ... pending writes win over what the device holds ...
+    std::array<uint8_t, 256> rx;
+    I2C::Transaction<2> transaction;
+    transaction.write(m_addr, buffer(&first, 1)).read(m_addr, buffer(rx.data(), count));
+    m_i2c->transfer(transaction);
+
+    for (std::size_t i = 0; i < count; ++i) {
+        std::size_t reg = first + i;
+        if (!m_volatile[reg] && !m_dirty[reg]) {
+            m_values[reg] = rx[i];
+            m_valid.set(reg);
+        }
+    }
+}
+
+
+void I2CRegisterCache::invalidate()
+{
+    m_valid.reset();
+    m_dirty.reset();
+}
+
+
+void I2CRegisterCache::mode(Mode mode)
+{
+    if (mode == Mode::WriteThrough) {
+        sync();
+    }
+    m_mode = mode;
+}
+
+
+} // ... namespace periphery ...
@@ -0,0 +1,208 @@
+/*
+ * cpp-periphery
+ * https://github.com/mpb27/cpp-periphery
+ * License: MIT
+ *
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstdint>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+#include "periphery/i2c_scheduler.hpp"
+
+namespace periphery {
+
+
+I2CScheduler::I2CScheduler(std::shared_ptr<I2C> i2c)
+    : m_i2c(i2c), m_stats(), m_batches(0), m_transactions(0), m_stop(false)
+{
+    m_thread = std::thread(&I2CScheduler::run, this);
+}
+
+
+I2CScheduler::~I2CScheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cv.notify_one();
+    m_thread.join();
+
+    // ... the worker is gone, fail whatever is left ...
+    for (auto& queue : m_queues) {
+        for (auto& job : queue) {
+            job.callback(std::make_error_code(std::errc::operation_canceled));
+        }
+    }
+}
+
+
+std::future<void> I2CScheduler::submit(Priority priority, const I2C::BufferMessage* messages, std::size_t count,
+                                       bool batchable)
+{
+    auto promise = std::make_shared<std::promise<void>>();
+    auto future = promise->get_future();
+
+    enqueue(priority, messages, count, [promise](std::error_code ec) {
+        if (ec) {
+            promise->set_exception(std::make_exception_ptr(std::system_error(ec)));
+        } else {
+            promise->set_value();
+        }
+    }, batchable);
+
+    return future;
+}
+
+
+void I2CScheduler::submit(Priority priority, const I2C::BufferMessage* messages, std::size_t count,
+                          Callback callback, bool batchable)
+{
+    enqueue(priority, messages, count, std::move(callback), batchable);
+}
+
+
+void I2CScheduler::enqueue(Priority priority, const I2C::BufferMessage* messages, std::size_t count,
+                           Callback callback, bool batchable)
+{
+    if (count == 0 || count > I2C::max_messages) {
+        throw std::invalid_argument("I2C transaction must hold 1 to 42 messages");
+    }
+
+    Job job;
+    job.messages.assign(messages, messages + count);
+    job.batchable = batchable;
+    job.submitted = clock::now();
+    job.callback = std::move(callback);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queues[static_cast<std::size_t>(priority)].push_back(std::move(job));
+    }
+    m_cv.notify_one();
+}
+
+
+void I2CScheduler::run()
+{
+    std::array<I2C::BufferMessage, I2C::max_messages> packed;
+    std::vector<std::pair<std::size_t, Job>> batch;
+    batch.reserve(I2C::max_messages);
+
+    for (;;) {
+        batch.clear();
+        std::size_t count = 0;
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait(lock, [this] {
+                return m_stop || std::any_of(m_queues.begin(), m_queues.end(),
+                                             [](const std::deque<Job>& q) { return !q.empty(); });
+            });
+            if (m_stop) {
+                return;
+            }
+
+            // ... take jobs in priority order while they fit, stop at the first one that does not
+            //     so no job is overtaken by a lower priority one ...
+            bool full = false;
+            for (std::size_t p = 0; p < num_priorities && !full; ++p) {
+                auto& queue = m_queues[p];
+                while (!queue.empty()) {
+                    auto& job = queue.front();
+                    bool alone = !job.batchable || (!batch.empty() && !batch.front().second.batchable);
+                    if (!batch.empty() && (alone || count + job.messages.size() > I2C::max_messages)) {
+                        full = true;
+                        break;
+                    }
+                    count += job.messages.size();
+                    batch.emplace_back(p, std::move(job));
+                    queue.pop_front();
+                }
+            }
+        }
+
+        // ... pack and send ...
+        std::size_t n = 0;
+        for (auto& entry : batch) {
+            for (auto& m : entry.second.messages) {
+                packed[n++] = m;
+            }
+        }
+
+        auto started = clock::now();
+        std::error_code ec;
+        try {
+            m_i2c->transfer(packed.data(), n);
+        } catch (const std::system_error& e) {
+            ec = e.code();
+        } catch (const std::exception&) {
+            ec = std::make_error_code(std::errc::io_error);
+        }
+        auto completed = clock::now();
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_batches++;
+            m_transactions += batch.size();
+            for (auto& entry : batch) {
+                auto& stats = m_stats[entry.first];
+                auto queued = std::chrono::duration_cast<std::chrono::nanoseconds>(started - entry.second.submitted);
+                auto total = std::chrono::duration_cast<std::chrono::nanoseconds>(completed - entry.second.submitted);
+                stats.count++;
+                stats.queue_total += queued;
+                stats.queue_max = std::max(stats.queue_max, queued);
+                stats.total_total += total;
+                stats.total_max = std::max(stats.total_max, total);
+            }
+        }
+
+        for (auto& entry : batch) {
+            entry.second.callback(ec);
+        }
+    }
+}
+
+
+I2CScheduler::LatencyStats I2CScheduler::latency(Priority priority) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const auto& stats = m_stats[static_cast<std::size_t>(priority)];
+
+    LatencyStats result;
+    result.count = stats.count;
+    result.queue_mean = stats.count ? stats.queue_total / static_cast<std::chrono::nanoseconds::rep>(stats.count) : std::chrono::nanoseconds(0);
+    result.queue_max = stats.queue_max;
+    result.total_mean = stats.count ? stats.total_total / static_cast<std::chrono::nanoseconds::rep>(stats.count) : std::chrono::nanoseconds(0);
+    result.total_max = stats.total_max;
+    return result;
+}
+
+
+void I2CScheduler::reset_latency()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats = decltype(m_stats)();
+}
+
+
+uint64_t I2CScheduler::batches() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_batches;
+}
+
+
+uint64_t I2CScheduler::transactions() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_transactions;
+}
+
+
+} // ... namespace periphery ...
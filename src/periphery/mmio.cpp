@@ -1,103 +1,514 @@
 
 // C++11 includes:
+#include <algorithm>
+#include <atomic>
 #include <cstdlib>
 #include <cstdint>
 #include <cstring>
+#include <fstream>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
 #include <system_error>
 
 // POSIX 2008 Headers:
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PERIPHERY_MMIO_X86 1
+#endif
 
 #include "periphery/mmio.hpp"
 
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23
+#endif
+
 namespace periphery {
 
-    Mmio::Mmio(uintptr_t base, size_t size) {
-        m_base = base;
-        m_size = size;
-        m_aligned_base = base - (base % sysconf(_SC_PAGESIZE));
-        m_aligned_size = size + (base - m_aligned_base);
+struct MmioMapping {
+    std::string source;
+    uint64_t    base;       // ... mmap offset of the window inside the source ...
+    uint64_t    begin;      // ... aligned, relative to base ...
+    uint64_t    end;
+    uint8_t*    ptr;
+    unsigned    refs;
+    bool        populated;
+    bool        locked;
+};
+
+namespace {
+
+    std::mutex& registry_mutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    std::list<MmioMapping>& registry() {
+        static std::list<MmioMapping> mappings;
+        return mappings;
+    }
 
-        // ... open memory ...
-        int fd = open("/dev/mem", O_RDWR, O_SYNC);
+    uint64_t huge_page_size() {
+        static const uint64_t size = [] {
+            std::ifstream meminfo("/proc/meminfo");
+            std::string key;
+            uint64_t kb;
+            while (meminfo >> key) {
+                if (key == "Hugepagesize:" && meminfo >> kb) {
+                    return kb * 1024;
+                }
+            }
+            return static_cast<uint64_t>(2 << 20);
+        }();
+        return size;
+    }
+
+    // ... mmap with the virtual address congruent to the file offset modulo align (what a huge page
+    //     mapping needs), by reserving align more and trimming, offset and length are unchanged ...
+    uint8_t* map_aligned(int fd, uint64_t offset, size_t length, int flags, size_t align) {
+        void* hint = nullptr;
+        void* reservation = MAP_FAILED;
+        if (align > static_cast<size_t>(sysconf(_SC_PAGESIZE))) {
+            reservation = mmap(nullptr, length + align, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            if (reservation != MAP_FAILED) {
+                uintptr_t r = reinterpret_cast<uintptr_t>(reservation);
+                uintptr_t a = (r + align - 1) & ~(static_cast<uintptr_t>(align) - 1);
+                hint = reinterpret_cast<void*>(a + static_cast<uintptr_t>(offset % align));
+                flags |= MAP_FIXED;
+            }
+        }
+        void* ptr = mmap(hint, length, PROT_READ | PROT_WRITE, flags, fd, static_cast<off_t>(offset));
+        if (reservation != MAP_FAILED) {
+            int error = errno;
+            uint8_t* r = static_cast<uint8_t*>(reservation);
+            uint8_t* h = static_cast<uint8_t*>(hint);
+            if (ptr == MAP_FAILED) {
+                munmap(r, length + align);
+            } else {
+                if (h > r) {
+                    munmap(r, h - r);
+                }
+                if (r + length + align > h + length) {
+                    munmap(h + length, (r + length + align) - (h + length));
+                }
+            }
+            errno = error;
+        }
+        return ptr == MAP_FAILED ? nullptr : static_cast<uint8_t*>(ptr);
+    }
+
+    // ... caller holds the registry mutex ...
+    void lock_mapping(MmioMapping& mapping, const Mmio::MapOptions& options) {
+        size_t length = mapping.end - mapping.begin;
+        if (options.lock && !mapping.locked) {
+            if (mlock(mapping.ptr, length) < 0) {
+                throw std::system_error(errno, std::system_category(), "mlock");
+            }
+            mapping.locked = true;
+            mapping.populated = true;
+        }
+        if (options.populate && !mapping.populated) {
+            // ... best effort on an existing mapping, fails on pfn maps which never fault anyway ...
+            madvise(mapping.ptr, length, MADV_POPULATE_WRITE);
+            mapping.populated = true;
+        }
+    }
+
+    MmioMapping* acquire(const Mmio::Region& region, const Mmio::MapOptions& options) {
+        const uint64_t page = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+        // ... the file range stays page granular, UIO, PCI resource files and STRICT_DEVMEM reject
+        //     anything beyond the region, huge pages only align the virtual address ...
+        const uint64_t align = options.huge_pages ? huge_page_size() : page;
+        const std::string& source = region.path;
+        const uint64_t offset = region.offset;
+        const uint64_t size = region.size;
+        uint64_t begin = region.from_start ? 0 : offset - (offset % page);
+        uint64_t end = offset + size;
+        end += (page - end % page) % page;
+        if (end == begin) {
+            end += page;
+        }
+
+        std::lock_guard<std::mutex> lock(registry_mutex());
+        auto& mappings = registry();
+
+        for (auto& m : mappings) {
+            if (m.source == source && m.base == region.base && m.begin <= offset && offset + size <= m.end) {
+                lock_mapping(m, options);
+                m.refs++;
+                return &m;
+            }
+        }
+
+        // ... partial overlaps are mapped as the union, the old mappings stay until released ...
+        for (auto& m : mappings) {
+            if (m.source == source && m.base == region.base && m.begin < end && begin < m.end) {
+                begin = std::min(begin, m.begin);
+                end = std::max(end, m.end);
+            }
+        }
+
+        // ... O_SYNC makes /dev/mem mappings of RAM uncached ...
+        int fd = open(source.c_str(), O_RDWR | (source == "/dev/mem" ? O_SYNC : 0));
         if (fd < 0) {
-            throw std::system_error(EFAULT, std::system_category());
+            throw std::system_error(errno, std::system_category(), source);
         }
 
-        // ... map memory ...
-        m_ptr = static_cast<uint8_t*>(mmap(0, m_aligned_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, m_aligned_base));
-        if (m_ptr  == MAP_FAILED) {
-            auto e = std::system_error(EFAULT, std::system_category());
-            close(fd);
-            throw e;
+        int flags = MAP_SHARED | (options.populate ? MAP_POPULATE : 0);
+        uint8_t* ptr = map_aligned(fd, region.base + begin, end - begin, flags, align);
+        int error = errno;
+        close(fd);
+        if (ptr == nullptr) {
+            throw std::system_error(error, std::system_category(), "mmap " + source);
+        }
+        if (options.huge_pages) {
+            madvise(ptr, end - begin, MADV_HUGEPAGE);
         }
 
-        // ... close memory ...
-        int error = close(fd);
-        if (error) {
-            auto e = std::system_error(EFAULT, std::system_category());
-            munmap(m_ptr, m_aligned_size);
-            throw e;
+        mappings.push_back(MmioMapping{ source, region.base, begin, end, ptr, 0, options.populate, false });
+        MmioMapping& m = mappings.back();
+        try {
+            lock_mapping(m, options);
+        } catch (...) {
+            munmap(m.ptr, m.end - m.begin);
+            mappings.pop_back();
+            throw;
         }
+        m.refs = 1;
+        return &m;
+    }
+
+    uint64_t read_sysfs_number(const std::string& path) {
+        std::ifstream file(path);
+        std::string text;
+        if (!(file >> text)) {
+            throw std::system_error(ENOENT, std::system_category(), path);
+        }
+        return std::strtoull(text.c_str(), nullptr, 0);
+    }
+
+    void release(MmioMapping* mapping) {
+        std::lock_guard<std::mutex> lock(registry_mutex());
+        if (--mapping->refs > 0) {
+            return;
+        }
+        auto& mappings = registry();
+        for (auto it = mappings.begin(); it != mappings.end(); ++it) {
+            if (&*it == mapping) {
+                if (munmap(it->ptr, it->end - it->begin) < 0) {
+                    // ... never throw from destructor ...
+                }
+                mappings.erase(it);
+                return;
+            }
+        }
+    }
+
+    // ... unrolled so the loads (or stores) issue back to back ...
+    template <typename T>
+    void burst_from(const volatile T* src, T* dst, size_t count) {
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            T a = src[i], b = src[i + 1], c = src[i + 2], d = src[i + 3];
+            dst[i] = a; dst[i + 1] = b; dst[i + 2] = c; dst[i + 3] = d;
+        }
+        for (; i < count; i++) {
+            dst[i] = src[i];
+        }
+    }
+
+    template <typename T>
+    void burst_to(const T* src, volatile T* dst, size_t count) {
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            T a = src[i], b = src[i + 1], c = src[i + 2], d = src[i + 3];
+            dst[i] = a; dst[i + 1] = b; dst[i + 2] = c; dst[i + 3] = d;
+        }
+        for (; i < count; i++) {
+            dst[i] = src[i];
+        }
+    }
+
+    template <typename T>
+    void fifo_from(const volatile T* reg, T* dst, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            dst[i] = *reg;
+        }
+    }
+
+    template <typename T>
+    void fifo_to(const T* src, volatile T* reg, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            *reg = src[i];
+        }
+    }
+
+#if defined(PERIPHERY_MMIO_X86)
+    bool has_stream_load() {
+        static const bool supported = __builtin_cpu_supports("sse4.1");
+        return supported;
+    }
+
+    // ... plain accesses until the device address is 16 byte aligned, MOVNTDQA, plain tail ...
+    template <typename T>
+    __attribute__((target("sse4.1")))
+    void stream_from(const volatile T* src, T* dst, size_t count) {
+        const size_t per = 16 / sizeof(T);
+        size_t i = 0;
+        for (; i < count && (reinterpret_cast<uintptr_t>(src + i) & 15) != 0; i++) {
+            dst[i] = src[i];
+        }
+        for (; i + per <= count; i += per) {
+            __m128i v = _mm_stream_load_si128(const_cast<__m128i*>(reinterpret_cast<const volatile __m128i*>(src + i)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), v);
+        }
+        for (; i < count; i++) {
+            dst[i] = src[i];
+        }
+    }
+
+    // ... same with MOVNTDQ, fenced so the data is globally visible on return ...
+    template <typename T>
+    __attribute__((target("sse2")))
+    void stream_to(const T* src, volatile T* dst, size_t count) {
+        const size_t per = 16 / sizeof(T);
+        size_t i = 0;
+        for (; i < count && (reinterpret_cast<uintptr_t>(dst + i) & 15) != 0; i++) {
+            dst[i] = src[i];
+        }
+        for (; i + per <= count; i += per) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+            _mm_stream_si128(const_cast<__m128i*>(reinterpret_cast<volatile __m128i*>(dst + i)), v);
+        }
+        for (; i < count; i++) {
+            dst[i] = src[i];
+        }
+        _mm_sfence();
+    }
+#endif
+
+    template <typename T>
+    void read_burst(const volatile T* src, T* dst, size_t count, bool non_temporal) {
+#if defined(PERIPHERY_MMIO_X86)
+        if (non_temporal && has_stream_load()) {
+            stream_from(src, dst, count);
+            return;
+        }
+#else
+        (void)non_temporal;
+#endif
+        burst_from(src, dst, count);
+    }
+
+    template <typename T>
+    void write_burst(const T* src, volatile T* dst, size_t count, bool non_temporal) {
+#if defined(PERIPHERY_MMIO_X86)
+        if (non_temporal) {
+            stream_to(src, dst, count);
+            return;
+        }
+#else
+        (void)non_temporal;
+#endif
+        burst_to(src, dst, count);
+    }
+
+    inline void cpu_relax() {
+#if defined(PERIPHERY_MMIO_X86)
+        _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+        __asm__ __volatile__("yield");
+#endif
+    }
+
+    // ... striped spin locks for modify*(), one cache line each ...
+    struct alignas(64) Stripe {
+        std::atomic<bool> locked;
+    };
+    Stripe stripes[64];
+
+    class StripeLock {
+    public:
+        explicit StripeLock(uint64_t key)
+            : m_locked(stripes[(key * 0x9E3779B97F4A7C15ull) >> 58].locked) {
+            while (m_locked.exchange(true, std::memory_order_acquire)) {
+                while (m_locked.load(std::memory_order_relaxed)) {
+                    cpu_relax();
+                }
+            }
+        }
+        ~StripeLock() { m_locked.store(false, std::memory_order_release); }
+
+        StripeLock(const StripeLock&) = delete;
+        StripeLock& operator=(const StripeLock&) = delete;
+    private:
+        std::atomic<bool>& m_locked;
+    };
+
+    template <typename T>
+    T locked_modify(volatile T* reg, uint64_t key, T clear, T set) {
+        StripeLock lock(key);
+        T value = *reg;
+        *reg = static_cast<T>((value & static_cast<T>(~clear)) | set);
+        return value;
+    }
+
+} // ... anonymous namespace ...
+
+    Mmio::Mmio(uintptr_t base, size_t size, MapOptions options)
+        : Mmio(dev_mem_region(base, size), options) {
+    }
+
+    Mmio::Mmio(const Region& region, MapOptions options) {
+        m_size = region.size;
+        m_mapping = acquire(region, options);
+        m_data = m_mapping->ptr + (region.offset - m_mapping->begin);
+        m_lock_key = (std::hash<std::string>()(region.path) ^ (region.base * 0x9E3779B97F4A7C15ull)) + region.offset;
+    }
+
+    Mmio::Region Mmio::dev_mem_region(uintptr_t base, size_t size) {
+        return Region{ "/dev/mem", 0, base, size, false };
+    }
+
+    Mmio::Region Mmio::uio_region(unsigned device, unsigned map) {
+        const std::string dir = "/sys/class/uio/uio" + std::to_string(device) + "/maps/map" + std::to_string(map) + "/";
+        const uint64_t page = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+
+        uint64_t size = read_sysfs_number(dir + "size");
+        // ... "offset" is missing on old kernels, it is the sub page part of the physical address ...
+        uint64_t offset = 0;
+        try {
+            offset = read_sysfs_number(dir + "offset");
+        } catch (const std::system_error&) {
+            offset = read_sysfs_number(dir + "addr") % page;
+        }
+        return Region{ "/dev/uio" + std::to_string(device), map * page, offset, static_cast<size_t>(size), true };
+    }
+
+    Mmio::Region Mmio::pci_region(const std::string& address, unsigned bar, bool write_combined) {
+        std::string path = "/sys/bus/pci/devices/" + address + "/resource" + std::to_string(bar)
+                         + (write_combined ? "_wc" : "");
+        struct stat st;
+        if (stat(path.c_str(), &st) < 0) {
+            throw std::system_error(errno, std::system_category(), path);
+        }
+        return Region{ path, 0, 0, static_cast<size_t>(st.st_size), false };
+    }
+
+    Mmio::Region Mmio::file_region(const std::string& path, uint64_t offset, size_t size) {
+        return Region{ path, 0, offset, size, false };
+    }
+
+    Mmio::Region Mmio::fd_region(int fd, uint64_t offset, size_t size) {
+        return Region{ "/proc/self/fd/" + std::to_string(fd), 0, offset, size, false };
     }
 
     Mmio::~Mmio() {
-        // ... unmap memory...
-        if (munmap(m_ptr, m_aligned_size) < 0) {
-            // ... never throw from destructor ...
+        release(m_mapping);
+    }
+
+    size_t Mmio::mappings() {
+        std::lock_guard<std::mutex> lock(registry_mutex());
+        return registry().size();
+    }
+
+    uint8_t* Mmio::range(size_t offset, size_t count, size_t width) const {
+        if (offset > m_size || count > (m_size - offset) / width) {
+            throw std::invalid_argument("access out of bounds");
         }
+        if (reinterpret_cast<uintptr_t>(m_data + offset) % width != 0) {
+            throw std::invalid_argument("access not aligned");
+        }
+        return m_data + offset;
+    }
+
+    void Mmio::read_burst32(size_t offset, uint32_t* buf, size_t count, bool non_temporal) const {
+        read_burst(reinterpret_cast<volatile uint32_t*>(range(offset, count, 4)), buf, count, non_temporal);
+    }
+
+    void Mmio::read_burst64(size_t offset, uint64_t* buf, size_t count, bool non_temporal) const {
+        read_burst(reinterpret_cast<volatile uint64_t*>(range(offset, count, 8)), buf, count, non_temporal);
     }
 
-    uint32_t Mmio::read32(size_t offset) const { return read<uint32_t>(offset); }
-    uint16_t Mmio::read16(size_t offset) const { return read<uint16_t>(offset); }
-    uint8_t  Mmio::read8(size_t offset)  const { return read<uint8_t >(offset); }
+    void Mmio::write_burst32(size_t offset, const uint32_t* buf, size_t count, bool non_temporal) const {
+        write_burst(buf, reinterpret_cast<volatile uint32_t*>(range(offset, count, 4)), count, non_temporal);
+    }
+
+    void Mmio::write_burst64(size_t offset, const uint64_t* buf, size_t count, bool non_temporal) const {
+        write_burst(buf, reinterpret_cast<volatile uint64_t*>(range(offset, count, 8)), count, non_temporal);
+    }
+
+    void Mmio::read_fifo32(size_t offset, uint32_t* buf, size_t count) const {
+        fifo_from(reinterpret_cast<volatile uint32_t*>(range(offset, 1, 4)), buf, count);
+    }
+
+    void Mmio::read_fifo64(size_t offset, uint64_t* buf, size_t count) const {
+        fifo_from(reinterpret_cast<volatile uint64_t*>(range(offset, 1, 8)), buf, count);
+    }
 
-    void Mmio::write32(size_t offset, uint32_t value) const { write<uint32_t>(offset, value); }
-    void Mmio::write16(size_t offset, uint16_t value) const { write<uint16_t>(offset, value); }
-    void Mmio::write8 (size_t offset, uint8_t value)  const { write<uint8_t>(offset, value); }
+    void Mmio::write_fifo32(size_t offset, const uint32_t* buf, size_t count) const {
+        fifo_to(buf, reinterpret_cast<volatile uint32_t*>(range(offset, 1, 4)), count);
+    }
+
+    void Mmio::write_fifo64(size_t offset, const uint64_t* buf, size_t count) const {
+        fifo_to(buf, reinterpret_cast<volatile uint64_t*>(range(offset, 1, 8)), count);
+    }
 
-    void Mmio::clear32(size_t offset, uint32_t mask) const { write32(offset, read32(offset) & ~mask); }
-    void Mmio::clear16(size_t offset, uint16_t mask) const { write16(offset, read16(offset) & ~mask); }
-    void Mmio::clear8 (size_t offset, uint8_t mask)  const { write8(offset, read8(offset) & ~mask); }
+    uint32_t Mmio::modify32(size_t offset, uint32_t clear, uint32_t set) const {
+        return locked_modify(reinterpret_cast<volatile uint32_t*>(range(offset, 1, 4)), m_lock_key + offset, clear, set);
+    }
 
-    void Mmio::set32(size_t offset, uint32_t mask) const { write32(offset, read32(offset) | mask); }
-    void Mmio::set16(size_t offset, uint16_t mask) const { write16(offset, read16(offset) | mask); }
-    void Mmio::set8 (size_t offset, uint8_t mask)  const { write8(offset, read8(offset) | mask); }
+    uint16_t Mmio::modify16(size_t offset, uint16_t clear, uint16_t set) const {
+        return locked_modify(reinterpret_cast<volatile uint16_t*>(range(offset, 1, 2)), m_lock_key + offset, clear, set);
+    }
+
+    uint8_t Mmio::modify8(size_t offset, uint8_t clear, uint8_t set) const {
+        return locked_modify(reinterpret_cast<volatile uint8_t*>(range(offset, 1, 1)), m_lock_key + offset, clear, set);
+    }
 
-    template<typename T> inline T Mmio::read(size_t offset) const {
-        offset += (m_base - m_aligned_base);
-        if ((offset + sizeof(T)) > m_aligned_size) {
-            throw std::invalid_argument("offset out of bounds");
+    uint32_t Mmio::atomic_modify32(size_t offset, uint32_t clear, uint32_t set) const {
+        uint32_t* reg = reinterpret_cast<uint32_t*>(range(offset, 1, 4));
+        uint32_t value = __atomic_load_n(reg, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(reg, &value, (value & ~clear) | set, true, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
         }
-        return *((volatile T*)(m_ptr + offset));
+        return value;
     }
 
-    template<typename T> inline void Mmio::write(size_t offset, T value) const {
-        offset += (m_base - m_aligned_base);
-        if ((offset + sizeof(T)) > m_aligned_size) {
-            throw std::invalid_argument("offset out of bounds");
+    bool Mmio::wait32(size_t offset, uint32_t mask, uint32_t value, std::chrono::nanoseconds timeout) const {
+        volatile uint32_t* reg = reinterpret_cast<volatile uint32_t*>(range(offset, 1, 4));
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        for (unsigned spins = 1; ; spins++) {
+            if ((*reg & mask) == value) {
+                return true;
+            }
+            // ... the clock is only read every 64 polls ...
+            if (spins % 64 == 0 && std::chrono::steady_clock::now() >= deadline) {
+                return (*reg & mask) == value;
+            }
+            cpu_relax();
         }
-        *((volatile T*)(m_ptr + offset)) = value;
     }
 
     // TODO: Use either std::span (C++17?) or two pointers cbegin cend in C++ fashion.
     //       If using begin/end, consider using std::copy
     void Mmio::read(size_t offset, uint8_t* buf, size_t len) const {
-        offset += (m_base - m_aligned_base);
-        if ((offset + len) > m_aligned_size) {
+        if (offset > m_size || len > m_size - offset) {
             throw std::invalid_argument("read out of bounds");
         }
-        memcpy(buf, m_ptr + offset, len);
+        memcpy(buf, m_data + offset, len);
     }
 
     void Mmio::write(size_t offset, const uint8_t* buf, size_t len) const {
-        offset += (m_base - m_aligned_base);
-        if ((offset + len) > m_aligned_size) {
+        if (offset > m_size || len > m_size - offset) {
             throw std::invalid_argument("write out of bounds");
         }
-        memcpy(m_ptr + offset, buf, len);
+        memcpy(m_data + offset, buf, len);
     }
 
 
@@ -0,0 +1,145 @@
+/*
+ * cpp-periphery
+ * https://github.com/mpb27/cpp-periphery
+ * License: MIT
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+
+#include "periphery/mmio_batch.hpp"
+
+namespace periphery {
+
+namespace {
+
+    uint64_t width_mask(uint8_t width) {
+        return width == 8 ? ~0ull : (1ull << (8 * width)) - 1;
+    }
+
+    inline void device_barrier() {
+#if defined(__x86_64__) || defined(__i386__)
+        __asm__ __volatile__("mfence" ::: "memory");
+#elif defined(__aarch64__)
+        __asm__ __volatile__("dmb osh" ::: "memory");
+#elif defined(__arm__)
+        __asm__ __volatile__("dmb" ::: "memory");
+#else
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+#endif
+    }
+
+    template <typename T>
+    void apply_op(uint8_t* base, size_t offset, bool plain, uint64_t mask, uint64_t value) {
+        volatile T* reg = reinterpret_cast<volatile T*>(base + offset);
+        if (plain) {
+            *reg = static_cast<T>(value);
+        } else {
+            *reg = static_cast<T>((*reg & static_cast<T>(~mask)) | static_cast<T>(value));
+        }
+    }
+
+    template <typename T>
+    void read_op(uint8_t* base, size_t offset) {
+        volatile T* reg = reinterpret_cast<volatile T*>(base + offset);
+        (void)*reg;
+    }
+
+} // ... anonymous namespace ...
+
+
+MmioBatch& MmioBatch::record(Kind kind, size_t offset, uint8_t width, uint64_t mask, uint64_t value)
+{
+    if (offset % width != 0) {
+        throw std::invalid_argument("batch register not aligned");
+    }
+    const uint64_t full = width_mask(width);
+    mask &= full;
+    value &= mask;
+    if (kind == Kind::Write) {
+        mask = full;
+    }
+
+    m_recorded++;
+    m_extent = std::max(m_extent, offset + width);
+    m_align = std::max<size_t>(m_align, width);
+
+    // ... a modify merges into the last modify of this register since the last barrier or read
+    //     back, unless any other overlapping access sits in between. A read back of any register
+    //     may have side effects (read to clear, posted write flush) so nothing moves across it.
+    //     Plain stores are never merged, repeated stores (pulses, doorbells, write-1-to-clear,
+    //     fifo data) all have to reach the device ...
+    if (kind == Kind::Modify) {
+        for (auto it = m_ops.rbegin(); it != m_ops.rend() && it->kind != Kind::Barrier && it->kind != Kind::Read;
+             ++it) {
+            bool overlaps = it->offset < offset + width && offset < it->offset + it->width;
+            if (!overlaps) {
+                continue;
+            }
+            if (it->kind != Kind::Modify || it->offset != offset || it->width != width) {
+                break;
+            }
+            it->value = (it->value & ~mask) | value;
+            it->mask |= mask;
+            if (it->mask == full) {
+                it->kind = Kind::Write;
+            }
+            return *this;
+        }
+    }
+
+    m_ops.push_back(Op{ offset, mask, value, width, mask == full ? Kind::Write : kind });
+    return *this;
+}
+
+MmioBatch& MmioBatch::barrier()
+{
+    m_recorded++;
+    // ... back to back barriers are one ...
+    if (!m_ops.empty() && m_ops.back().kind != Kind::Barrier) {
+        m_ops.push_back(Op{ 0, 0, 0, 0, Kind::Barrier });
+    }
+    return *this;
+}
+
+void MmioBatch::clear()
+{
+    m_ops.clear();
+    m_recorded = 0;
+    m_extent = 0;
+    m_align = 1;
+}
+
+void MmioBatch::apply(const Mmio& mmio, size_t offset) const
+{
+    if (offset > mmio.size() || m_extent > mmio.size() - offset) {
+        throw std::invalid_argument("batch out of bounds");
+    }
+    uint8_t* base = static_cast<uint8_t*>(mmio.ptr()) + offset;
+    if (reinterpret_cast<uintptr_t>(base) % m_align != 0) {
+        throw std::invalid_argument("batch base not aligned");
+    }
+
+    for (const Op& op : m_ops) {
+        bool plain = op.kind == Kind::Write;
+        switch (op.kind) {
+        case Kind::Barrier:
+            device_barrier();
+            break;
+        case Kind::Read:
+            read_op<uint32_t>(base, op.offset);
+            break;
+        default:
+            switch (op.width) {
+            case 1: apply_op<uint8_t >(base, op.offset, plain, op.mask, op.value); break;
+            case 2: apply_op<uint16_t>(base, op.offset, plain, op.mask, op.value); break;
+            case 4: apply_op<uint32_t>(base, op.offset, plain, op.mask, op.value); break;
+            default: apply_op<uint64_t>(base, op.offset, plain, op.mask, op.value); break;
+            }
+            break;
+        }
+    }
+}
+
+} // ... namespace periphery ...
@@ -5,9 +5,14 @@
  *
  */
 
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
 #include <cstdlib>
 #include <cstdint>
 #include <cstring>
+#include <fstream>
+#include <stdexcept>
 #include <system_error>
 #include <string>
 #include <ostream>
@@ -20,10 +25,78 @@
 #include <linux/spi/spidev.h>
 #include "periphery/spi.hpp"
 
+// ... octal bits are missing from older uapi headers ...
+#ifndef SPI_TX_OCTAL
+#define SPI_TX_OCTAL 0x2000
+#endif
+#ifndef SPI_RX_OCTAL
+#define SPI_RX_OCTAL 0x4000
+#endif
+
 namespace periphery {
 
+static constexpr uint32_t tx_width_mask = SPI_TX_DUAL | SPI_TX_QUAD | SPI_TX_OCTAL;
+static constexpr uint32_t rx_width_mask = SPI_RX_DUAL | SPI_RX_QUAD | SPI_RX_OCTAL;
+
+static uint32_t tx_width_flags(Spi::BusWidth width)
+{
+    switch (width) {
+        case Spi::BusWidth::Dual:  return SPI_TX_DUAL;
+        case Spi::BusWidth::Quad:  return SPI_TX_QUAD;
+        case Spi::BusWidth::Octal: return SPI_TX_OCTAL;
+        default:                   return 0;
+    }
+}
+
+static uint32_t rx_width_flags(Spi::BusWidth width)
+{
+    switch (width) {
+        case Spi::BusWidth::Dual:  return SPI_RX_DUAL;
+        case Spi::BusWidth::Quad:  return SPI_RX_QUAD;
+        case Spi::BusWidth::Octal: return SPI_RX_OCTAL;
+        default:                   return 0;
+    }
+}
+
+static Spi::BusWidth width_from_flags(uint32_t flags, uint32_t dual, uint32_t quad, uint32_t octal)
+{
+    return (flags & octal) ? Spi::BusWidth::Octal
+         : (flags & quad)  ? Spi::BusWidth::Quad
+         : (flags & dual)  ? Spi::BusWidth::Dual
+         : Spi::BusWidth::Single;
+}
+
+
+inline void ioctl_with_throw(int fd, unsigned long int request, void* ptr)
+{
+    int error = ioctl(fd, request, ptr);
+    if (error < 0) {
+        throw std::system_error(errno, std::system_category());
+    }
+}
+
+template<typename T>
+inline T ioctl_get_wt(int fd, unsigned long int request)
+{
+    static_assert(
+        std::is_same<T, uint32_t>::value || std::is_same<T, uint16_t>::value || std::is_same<T, uint8_t>::value,
+        "Must be 8, 16, or 32bit value.");
+    T value = 0;
+    ioctl_with_throw(fd, request, &value);
+    return value;
+}
+
+template<typename T>
+inline void ioctl_set_wt(int fd, unsigned long int request, T value)
+{
+    static_assert(
+        std::is_same<T, uint32_t>::value || std::is_same<T, uint16_t>::value || std::is_same<T, uint8_t>::value,
+        "Must be 8, 16, or 32bit value.");
+    ioctl_with_throw(fd, request, &value);
+}
+
 
-Spi::Spi(const std::string& path, Mode mode, BitOrder bit_order, uint32_t speed, uint8_t bits_per_word, uint8_t extra_flags)
+Spi::Spi(const std::string& path, Mode mode, BitOrder bit_order, uint32_t speed, uint8_t bits_per_word, uint32_t extra_flags)
 {
     int error;
 
@@ -33,11 +106,11 @@ Spi::Spi(const std::string& path, Mode mode, BitOrder bit_order, uint32_t speed,
         throw std::system_error(EFAULT, std::system_category());
     }
 
-    // ... set mode, bit order flags ...
-    uint8_t flags = static_cast<uint8_t>(mode)
-                    | ((bit_order == BitOrder::LsbFirst) ? SPI_LSB_FIRST : 0)
-                    | extra_flags;
-    error = ioctl(m_fd, SPI_IOC_WR_MODE, &flags);
+    // ... set mode, bit order flags, the 32 bit word so that wide mode flags can be passed ...
+    uint32_t flags = static_cast<uint32_t>(mode)
+                     | ((bit_order == BitOrder::LsbFirst) ? SPI_LSB_FIRST : 0)
+                     | extra_flags;
+    error = ioctl(m_fd, SPI_IOC_WR_MODE32, &flags);
     if (error < 0) {
         auto e = std::system_error(EFAULT, std::system_category());
         close(m_fd);
@@ -59,6 +132,16 @@ Spi::Spi(const std::string& path, Mode mode, BitOrder bit_order, uint32_t speed,
         close(m_fd);
         throw e;
     }
+
+    // ... shadow copy of what the driver accepted, getters never touch the device ...
+    try {
+        m_mode_flags = ioctl_get_wt<uint32_t>(m_fd, SPI_IOC_RD_MODE32);
+        m_speed = ioctl_get_wt<uint32_t>(m_fd, SPI_IOC_RD_MAX_SPEED_HZ);
+        m_bits_per_word = ioctl_get_wt<uint8_t>(m_fd, SPI_IOC_RD_BITS_PER_WORD);
+    } catch (...) {
+        close(m_fd);
+        throw;
+    }
 }
 
 Spi::Spi(const std::string& path, Mode mode, BitOrder bit_order, uint32_t speed, uint8_t bits_per_word)
@@ -78,49 +161,33 @@ Spi::~Spi()
 }
 
 
-inline void ioctl_with_throw(int fd, unsigned long int request, void* ptr)
-{
-    int error = ioctl(fd, request, ptr);
-    if (error < 0) {
-        throw std::system_error(EFAULT, std::system_category());
-    }
-}
-
-template<typename T>
-inline T ioctl_get_wt(int fd, unsigned long int request)
+void Spi::mode(Spi::Mode mode)
 {
-    static_assert(
-        std::is_same<T, uint32_t>::value || std::is_same<T, uint16_t>::value || std::is_same<T, uint8_t>::value,
-        "Must be 8, 16, or 32bit value.");
-    T value = 0;
-    ioctl_with_throw(fd, request, &value);
-    return value;
+    // ... update the bits of the shadow word, SPI_IOC_WR_MODE would clear the bits above 7 ...
+    uint32_t data32 = m_mode_flags;
+    data32 &= ~static_cast<uint32_t>(SPI_CPOL | SPI_CPHA);
+    data32 |= static_cast<uint32_t>(mode);
+    mode_flags(data32);
 }
 
-template<typename T>
-inline void ioctl_set_wt(int fd, unsigned long int request, T value)
+void Spi::mode_flags(uint32_t flags)
 {
-    static_assert(
-        std::is_same<T, uint32_t>::value || std::is_same<T, uint16_t>::value || std::is_same<T, uint8_t>::value,
-        "Must be 8, 16, or 32bit value.");
-    ioctl_with_throw(fd, request, &value);
+    ioctl_set_wt<uint32_t>(m_fd, SPI_IOC_WR_MODE32, flags);
+    // ... spi_setup() drops unsupported bus width bits without an error and rejects any other
+    //     unsupported bit, so only a bus width change needs the read back ...
+    if ((flags ^ m_mode_flags) & (tx_width_mask | rx_width_mask)) {
+        m_mode_flags = ioctl_get_wt<uint32_t>(m_fd, SPI_IOC_RD_MODE32);
+    } else {
+        m_mode_flags = flags;
+    }
 }
 
-void Spi::mode(Spi::Mode mode)
+void Spi::bus_width(BusWidth tx, BusWidth rx)
 {
-    //uint8_t data8;
-
-    // ... read the mode byte + other things ...
-    //ioctl_with_throw(m_fd, SPI_IOC_RD_MODE, &data8);
-    uint8_t data8 = ioctl_get_wt<uint8_t>(m_fd, SPI_IOC_RD_MODE);
-
-    // ... update the bits ...
-    data8 &= ~(SPI_CPOL | SPI_CPHA);
-    data8 |= static_cast<uint8_t>(mode);
-
-    // ... write the mode byte + other things ...
-    //ioctl_with_throw(m_fd, SPI_IOC_WR_MODE, &data8);
-    ioctl_set_wt<uint8_t>(m_fd, SPI_IOC_WR_MODE, data8);
+    uint32_t data32 = m_mode_flags;
+    data32 &= ~(tx_width_mask | rx_width_mask);
+    data32 |= tx_width_flags(tx) | rx_width_flags(rx);
+    mode_flags(data32);
 }
 
 void Spi::bit_order(Spi::BitOrder bit_order)
@@ -129,69 +196,131 @@ void Spi::bit_order(Spi::BitOrder bit_order)
     uint8_t data8 = (bit_order == BitOrder::LsbFirst) ? 1 : 0;
     // ... write the mode byte + other things ...
     ioctl_with_throw(m_fd, SPI_IOC_WR_LSB_FIRST, &data8);
+    m_mode_flags = data8 ? (m_mode_flags | SPI_LSB_FIRST) : (m_mode_flags & ~static_cast<uint32_t>(SPI_LSB_FIRST));
 }
 
 void Spi::bits_per_word(uint8_t bits_per_word)
 {
     ioctl_with_throw(m_fd, SPI_IOC_WR_BITS_PER_WORD, &bits_per_word);
+    m_bits_per_word = bits_per_word;
 }
 
 void Spi::speed(uint32_t speed)
 {
     ioctl_with_throw(m_fd, SPI_IOC_WR_MAX_SPEED_HZ, &speed);
+    m_speed = speed;
 }
 
 Spi::Mode Spi::mode() const
 {
-    // ... read the mode byte + other things ...
-    uint8_t data8;
-    ioctl_with_throw(m_fd, SPI_IOC_RD_MODE, &data8);
-    // ... clear non mode bits and return ...
-    data8 &= (SPI_CPOL | SPI_CPHA);
-    return static_cast<Mode>(data8);
+    return static_cast<Mode>(m_mode_flags & (SPI_CPOL | SPI_CPHA));
 }
 
 Spi::BitOrder Spi::bit_order() const
 {
-    // ... read the bit order + other things ...
-    uint8_t data8;
-    ioctl_with_throw(m_fd, SPI_IOC_RD_LSB_FIRST, &data8);
-    // ... clear non mode bits and return ...
-    return (data8 & SPI_LSB_FIRST) == 0 ? Spi::BitOrder::MsbFirst : Spi::BitOrder::LsbFirst;
+    return (m_mode_flags & SPI_LSB_FIRST) == 0 ? Spi::BitOrder::MsbFirst : Spi::BitOrder::LsbFirst;
+}
+
+Spi::BusWidth Spi::tx_bus_width() const
+{
+    return width_from_flags(m_mode_flags, SPI_TX_DUAL, SPI_TX_QUAD, SPI_TX_OCTAL);
 }
 
-uint32_t Spi::speed() const
+Spi::BusWidth Spi::rx_bus_width() const
 {
-    //return ioctl_get_wt<uint32_t>(m_fd, SPI_IOC_RD_MAX_SPEED_HZ);
-    uint32_t speed;
-    ioctl_with_throw(m_fd, SPI_IOC_RD_MAX_SPEED_HZ, &speed);
-    return speed;
+    return width_from_flags(m_mode_flags, SPI_RX_DUAL, SPI_RX_QUAD, SPI_RX_OCTAL);
 }
 
-uint8_t Spi::bits_per_word() const
+
+std::size_t Spi::max_transfer_size()
 {
-    uint8_t bits_per_word;
-    ioctl_with_throw(m_fd, SPI_IOC_RD_BITS_PER_WORD, &bits_per_word);
-    return bits_per_word;
+    // ... spidev rejects messages whose transmit or receive bytes exceed bufsiz with EMSGSIZE, 4096
+    //     unless changed at load ...
+    static const std::size_t bufsiz = [] {
+        std::size_t value = 0;
+        std::ifstream file("/sys/module/spidev/parameters/bufsiz");
+        if (!(file >> value) || value == 0) {
+            value = 4096;
+        }
+        return value;
+    }();
+    return bufsiz;
 }
 
 
 void Spi::transfer(const uint8_t* txbuf, uint8_t* rxbuf, size_t len) const
 {
-    struct spi_ioc_transfer spi_xfer;
+    transfer(txbuf, rxbuf, len, ChipSelect::Hold);
+}
+
+
+void Spi::transfer(const uint8_t* txbuf, uint8_t* rxbuf, size_t len, ChipSelect cs) const
+{
+    transfer(txbuf, rxbuf, len, 0, 0, cs);
+}
+
+
+void Spi::transfer(const uint8_t* txbuf, uint8_t* rxbuf, size_t len, uint32_t speed, uint8_t bits_per_word,
+                   ChipSelect cs) const
+{
+    // ... null buffers are allowed, the kernel shifts out zeros / discards the input ...
+    const std::size_t chunk = max_transfer_size();
+
+    // ... every message carries a full bufsiz, the fewest ioctls spidev allows, cs_change on the
+    //     last segment of a message keeps CS asserted into the next one ...
+    std::size_t offset = 0;
+    do {
+        std::size_t n = std::min(chunk, len - offset);
+        Segment segment(txbuf ? txbuf + offset : nullptr, rxbuf ? rxbuf + offset : nullptr, n);
+        segment.speed(speed).bits_per_word(bits_per_word);
+        if (cs == ChipSelect::Hold && offset + n < len) {
+            segment.cs_change(true);
+        }
+        transfer(&segment, 1);
+        offset += n;
+    } while (offset < len);
+}
+
+
+void Spi::transfer(const Segment* segments, std::size_t count) const
+{
+    // ... Segment arrays are passed to SPI_IOC_MESSAGE as they are ...
+    static_assert(sizeof(Segment) == sizeof(struct spi_ioc_transfer), "Spi::Segment size mismatch");
+    static_assert(offsetof(Segment, m_tx_buf) == offsetof(struct spi_ioc_transfer, tx_buf), "Spi::Segment layout mismatch");
+    static_assert(offsetof(Segment, m_rx_buf) == offsetof(struct spi_ioc_transfer, rx_buf), "Spi::Segment layout mismatch");
+    static_assert(offsetof(Segment, m_len) == offsetof(struct spi_ioc_transfer, len), "Spi::Segment layout mismatch");
+    static_assert(offsetof(Segment, m_speed_hz) == offsetof(struct spi_ioc_transfer, speed_hz), "Spi::Segment layout mismatch");
+    static_assert(offsetof(Segment, m_delay_usecs) == offsetof(struct spi_ioc_transfer, delay_usecs), "Spi::Segment layout mismatch");
+    static_assert(offsetof(Segment, m_bits_per_word) == offsetof(struct spi_ioc_transfer, bits_per_word), "Spi::Segment layout mismatch");
+    static_assert(offsetof(Segment, m_cs_change) == offsetof(struct spi_ioc_transfer, cs_change), "Spi::Segment layout mismatch");
+    static_assert(offsetof(Segment, m_tx_nbits) == offsetof(struct spi_ioc_transfer, tx_nbits), "Spi::Segment layout mismatch");
+    static_assert(offsetof(Segment, m_rx_nbits) == offsetof(struct spi_ioc_transfer, rx_nbits), "Spi::Segment layout mismatch");
+    static_assert(offsetof(Segment, m_word_delay_usecs) == offsetof(struct spi_ioc_transfer, word_delay_usecs), "Spi::Segment layout mismatch");
+    static_assert(SPI_MSGSIZE(max_segments) != 0 && SPI_MSGSIZE(max_segments + 1) == 0, "Spi::max_segments mismatch");
+
+    if (count == 0) {
+        return;
+    }
+    if (count > max_segments) {
+        throw std::invalid_argument("too many SPI segments in one transfer");
+    }
+
+    // ... spidev limits the transmit and the receive bytes of a message to bufsiz separately, with
+    //     each segment rounded up to ARCH_KMALLOC_MINALIGN (up to 128 on arm64 before 6.5), which
+    //     is not known here, so the kernel decides and its EMSGSIZE becomes std::length_error ...
+    int error = ioctl(m_fd, SPI_IOC_MESSAGE(count), segments);
+    if (error < 0) {
+        if (errno == EMSGSIZE) {
+            throw std::length_error("SPI message exceeds spidev bufsiz (transmit or receive bytes)");
+        }
+        throw std::system_error(errno, std::system_category(), "SPI_IOC_MESSAGE");
+    }
+}
 
-    /* Prepare SPI transfer structure */
-    memset(&spi_xfer, 0, sizeof(struct spi_ioc_transfer));
-    spi_xfer.tx_buf = (__u64)txbuf;
-    spi_xfer.rx_buf = (__u64)rxbuf;
-    spi_xfer.len = len;
-    spi_xfer.delay_usecs = 0;
-    spi_xfer.speed_hz = 0;
-    spi_xfer.bits_per_word = 0;
-    spi_xfer.cs_change = 0;
 
-    /* Transfer */
-    ioctl_with_throw(m_fd, SPI_IOC_MESSAGE(1), &spi_xfer);
+void Spi::transfer(std::initializer_list<Segment> segments) const
+{
+    transfer(segments.begin(), segments.size());
 }
 
 
@@ -201,7 +330,7 @@ std::ostream& operator<<(std::ostream& stream, const Spi& spi)
            << ", mode=" << static_cast<int>(spi.mode())
            << ", speed=" << spi.speed()
            << ", bit_order=" <<  (spi.bit_order() == Spi::BitOrder::MsbFirst ? "MSB first" : "LSB first")
-           << ", bits_per_word=" << spi.bits_per_word()
+           << ", bits_per_word=" << static_cast<int>(spi.bits_per_word())
            << ")";
     return stream;
 }
@@ -0,0 +1,217 @@
+/*
+ * cpp-periphery
+ * https://github.com/mpb27/cpp-periphery
+ * License: MIT
+ *
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include "periphery/spi_acquisition.hpp"
+
+namespace periphery {
+
+static uint64_t monotonic_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+static std::size_t round_up_pow2(std::size_t n)
+{
+    std::size_t p = 1;
+    while (p < n) {
+        p <<= 1;
+    }
+    return p;
+}
+
+
+SpiAcquisition::SpiAcquisition(std::shared_ptr<Spi> spi, const Spi::Segment* segments, std::size_t count,
+                               mutable_buffer frame, std::chrono::nanoseconds period, std::size_t ring_frames)
+    : SpiAcquisition([spi](const Spi::Segment* s, std::size_t n) { spi->transfer(s, n); },
+                     segments, count, frame, period, ring_frames) { }
+
+
+SpiAcquisition::SpiAcquisition(TransferFunction transfer, const Spi::Segment* segments, std::size_t count,
+                               mutable_buffer frame, std::chrono::nanoseconds period, std::size_t ring_frames)
+    : m_transfer(std::move(transfer)),
+      m_segments(segments, segments + count),
+      m_frame(static_cast<const uint8_t*>(frame.data())),
+      m_frame_size(frame.size()),
+      m_period(period),
+      m_capacity(round_up_pow2(std::max<std::size_t>(ring_frames, 2))),
+      m_headers(m_capacity),
+      m_data(m_capacity * frame.size()),
+      m_head(0), m_tail(0),
+      m_stop(false),
+      m_frames(0), m_overruns(0), m_missed(0), m_errors(0), m_max_jitter_ns(0)
+{
+    if (count == 0 || count > Spi::max_segments) {
+        throw std::invalid_argument("SPI acquisition plan must hold 1 to 511 segments");
+    }
+    if (period.count() <= 0) {
+        throw std::invalid_argument("SPI acquisition period must be positive");
+    }
+    for (auto& bucket : m_histogram) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+
+SpiAcquisition::~SpiAcquisition()
+{
+    stop();
+}
+
+
+void SpiAcquisition::start()
+{
+    if (m_thread.joinable()) {
+        return;
+    }
+    m_stop.store(false);
+    m_thread = std::thread(&SpiAcquisition::run, this);
+}
+
+
+void SpiAcquisition::stop()
+{
+    if (!m_thread.joinable()) {
+        return;
+    }
+    m_stop.store(true);
+    m_thread.join();
+}
+
+
+bool SpiAcquisition::realtime(int priority)
+{
+    if (!m_thread.joinable()) {
+        return false;
+    }
+    struct sched_param param;
+    std::memset(&param, 0, sizeof(param));
+    param.sched_priority = priority;
+    return pthread_setschedparam(m_thread.native_handle(), SCHED_FIFO, &param) == 0;
+}
+
+
+void SpiAcquisition::run()
+{
+    const uint64_t period = static_cast<uint64_t>(m_period.count());
+    uint64_t deadline = monotonic_ns();
+    uint64_t sequence = 0;
+
+    while (!m_stop.load(std::memory_order_relaxed)) {
+        struct timespec ts;
+        ts.tv_sec = static_cast<time_t>(deadline / 1000000000ULL);
+        ts.tv_nsec = static_cast<long>(deadline % 1000000000ULL);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) { }
+
+        uint64_t now = monotonic_ns();
+        uint64_t late = now > deadline ? now - deadline : 0;
+        record_jitter(late);
+
+        try {
+            m_transfer(m_segments.data(), m_segments.size());
+
+            // ... push, or drop and count an overrun when the consumer is behind ...
+            std::size_t head = m_head.load(std::memory_order_relaxed);
+            if (head - m_tail.load(std::memory_order_acquire) == m_capacity) {
+                m_overruns.fetch_add(1, std::memory_order_relaxed);
+            } else {
+                std::size_t slot = head & (m_capacity - 1);
+                m_headers[slot].timestamp_ns = now;
+                m_headers[slot].sequence = sequence;
+                std::memcpy(&m_data[slot * m_frame_size], m_frame, m_frame_size);
+                m_head.store(head + 1, std::memory_order_release);
+                m_frames.fetch_add(1, std::memory_order_relaxed);
+            }
+        } catch (const std::exception&) {
+            m_errors.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // ... next deadline, skip the periods that are already over ...
+        deadline += period;
+        sequence++;
+        now = monotonic_ns();
+        if (now > deadline + period) {
+            uint64_t skipped = (now - deadline) / period;
+            deadline += skipped * period;
+            sequence += skipped;
+            m_missed.fetch_add(skipped, std::memory_order_relaxed);
+        }
+    }
+}
+
+
+void SpiAcquisition::record_jitter(uint64_t late_ns)
+{
+    std::size_t bucket = 0;
+    uint64_t us = late_ns / 1000;
+    while (us != 0 && bucket < histogram_buckets - 1) {
+        us >>= 1;
+        bucket++;
+    }
+    m_histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t max = m_max_jitter_ns.load(std::memory_order_relaxed);
+    if (late_ns > max) {
+        m_max_jitter_ns.store(late_ns, std::memory_order_relaxed);
+    }
+}
+
+
+bool SpiAcquisition::pop(Frame& frame, mutable_buffer data)
+{
+    std::size_t tail = m_tail.load(std::memory_order_relaxed);
+    if (tail == m_head.load(std::memory_order_acquire)) {
+        return false;
+    }
+    std::size_t slot = tail & (m_capacity - 1);
+    frame = m_headers[slot];
+    std::memcpy(data.data(), &m_data[slot * m_frame_size], std::min(data.size(), m_frame_size));
+    m_tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+
+std::size_t SpiAcquisition::available() const
+{
+    return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_relaxed);
+}
+
+
+std::array<uint64_t, SpiAcquisition::histogram_buckets> SpiAcquisition::jitter_histogram() const
+{
+    std::array<uint64_t, histogram_buckets> result;
+    for (std::size_t i = 0; i < histogram_buckets; i++) {
+        result[i] = m_histogram[i].load(std::memory_order_relaxed);
+    }
+    return result;
+}
+
+
+void SpiAcquisition::reset_statistics()
+{
+    m_frames.store(0, std::memory_order_relaxed);
+    m_overruns.store(0, std::memory_order_relaxed);
+    m_missed.store(0, std::memory_order_relaxed);
+    m_errors.store(0, std::memory_order_relaxed);
+    m_max_jitter_ns.store(0, std::memory_order_relaxed);
+    for (auto& bucket : m_histogram) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+
+} // ... namespace periphery ...
@@ -0,0 +1,445 @@
+/*
+ * cpp-periphery
+ * https://github.com/mpb27/cpp-periphery
+ * License: MIT
+ *
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PERIPHERY_SPI_DISPLAY_X86 1
+#elif defined(__aarch64__) && defined(PERIPHERY_NEON)
+#include <arm_neon.h>
+#define PERIPHERY_SPI_DISPLAY_NEON 1
+#endif
+
+#include "periphery/spi_display.hpp"
+#include "periphery/spi_pack.hpp"
+
+namespace periphery {
+
+// ... MIPI DCS commands ...
+static constexpr uint8_t dcs_caset = 0x2A;
+static constexpr uint8_t dcs_raset = 0x2B;
+static constexpr uint8_t dcs_ramwr = 0x2C;
+
+// ... a window costs about as much as this many pixels on the wire (3 D/C switches, 6 messages) ...
+static constexpr uint32_t window_cost = 256;
+
+static uint32_t area(const SpiDisplay::Rect& r)
+{
+    return static_cast<uint32_t>(r.w) * r.h;
+}
+
+static SpiDisplay::Rect bounding(const SpiDisplay::Rect& a, const SpiDisplay::Rect& b)
+{
+    uint16_t x0 = std::min(a.x, b.x);
+    uint16_t y0 = std::min(a.y, b.y);
+    uint16_t x1 = static_cast<uint16_t>(std::max(a.x + a.w, b.x + b.w));
+    uint16_t y1 = static_cast<uint16_t>(std::max(a.y + a.h, b.y + b.h));
+    return SpiDisplay::Rect{ x0, y0, static_cast<uint16_t>(x1 - x0), static_cast<uint16_t>(y1 - y0) };
+}
+
+// ... merge while sending the bounding box is cheaper than two windows, then down to max_windows,
+//     overlapping windows that survive are sent twice so when they add up to more than the screen
+//     (limit pixels, the size of a transmit buffer) everything becomes one bounding window ...
+static void merge_rects(std::vector<SpiDisplay::Rect>& rects, uint32_t limit)
+{
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        for (std::size_t i = 0; i < rects.size() && !merged; i++) {
+            for (std::size_t j = i + 1; j < rects.size(); j++) {
+                auto u = bounding(rects[i], rects[j]);
+                if (area(u) <= area(rects[i]) + area(rects[j]) + window_cost) {
+                    rects[i] = u;
+                    rects.erase(rects.begin() + static_cast<std::ptrdiff_t>(j));
+                    merged = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    while (rects.size() > SpiDisplay::max_windows) {
+        std::size_t bi = 0, bj = 1;
+        int64_t best = INT64_MAX;
+        for (std::size_t i = 0; i < rects.size(); i++) {
+            for (std::size_t j = i + 1; j < rects.size(); j++) {
+                int64_t growth = static_cast<int64_t>(area(bounding(rects[i], rects[j])))
+                               - area(rects[i]) - area(rects[j]);
+                if (growth < best) {
+                    best = growth;
+                    bi = i;
+                    bj = j;
+                }
+            }
+        }
+        rects[bi] = bounding(rects[bi], rects[bj]);
+        rects.erase(rects.begin() + static_cast<std::ptrdiff_t>(bj));
+    }
+
+    uint64_t total = 0;
+    for (const auto& rect : rects) {
+        total += area(rect);
+    }
+    if (total > limit) {
+        for (std::size_t i = 1; i < rects.size(); i++) {
+            rects[0] = bounding(rects[0], rects[i]);
+        }
+        rects.resize(1);
+    }
+}
+
+// ... pixel conversion to big endian RGB565, hi = R[7:3] G[7:5], lo = G[4:2] B[7:3] ...
+
+static void rgb888_scalar(const uint8_t* src, uint8_t* dst, std::size_t n)
+{
+    for (std::size_t i = 0; i < n; i++, src += 3, dst += 2) {
+        dst[0] = static_cast<uint8_t>((src[0] & 0xF8) | (src[1] >> 5));
+        dst[1] = static_cast<uint8_t>(((src[1] << 3) & 0xE0) | (src[2] >> 3));
+    }
+}
+
+static void rgb565_scalar(const uint8_t* src, uint8_t* dst, std::size_t n)
+{
+    for (std::size_t i = 0; i < n; i++, src += 2, dst += 2) {
+        dst[0] = src[1];
+        dst[1] = src[0];
+    }
+}
+
+#if defined(PERIPHERY_SPI_DISPLAY_X86)
+
+__attribute__((target("sse4.1")))
+static std::size_t rgb888_sse41(const uint8_t* src, uint8_t* dst, std::size_t n)
+{
+    // ... 4 pixels per 12 byte load spread into 32 bit lanes R | G << 8 | B << 16 ...
+    const __m128i spread = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i lo_out = _mm_setr_epi8(1, 0, 5, 4, 9, 8, 13, 12, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i hi_out = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, 1, 0, 5, 4, 9, 8, 13, 12);
+    const __m128i mr = _mm_set1_epi32(0xF800);
+    const __m128i mg = _mm_set1_epi32(0x07E0);
+    const __m128i mb = _mm_set1_epi32(0x001F);
+
+    std::size_t i = 0;
+    // ... the second load reads 16 bytes from pixel 4, stay inside the source ...
+    for (; i + 8 <= n && (i + 4) * 3 + 16 <= n * 3; i += 8) {
+        __m128i a = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3)), spread);
+        __m128i b = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3 + 12)), spread);
+        a = _mm_or_si128(_mm_or_si128(_mm_and_si128(_mm_slli_epi32(a, 8), mr),
+                                      _mm_and_si128(_mm_srli_epi32(a, 5), mg)),
+                         _mm_and_si128(_mm_srli_epi32(a, 19), mb));
+        b = _mm_or_si128(_mm_or_si128(_mm_and_si128(_mm_slli_epi32(b, 8), mr),
+                                      _mm_and_si128(_mm_srli_epi32(b, 5), mg)),
+                         _mm_and_si128(_mm_srli_epi32(b, 19), mb));
+        __m128i out = _mm_or_si128(_mm_shuffle_epi8(a, lo_out), _mm_shuffle_epi8(b, hi_out));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 2), out);
+    }
+    return i;
+}
+
+__attribute__((target("sse4.1")))
+static std::size_t rgb565_sse41(const uint8_t* src, uint8_t* dst, std::size_t n)
+{
+    const __m128i swap = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 2), _mm_shuffle_epi8(v, swap));
+    }
+    return i;
+}
+
+#endif // PERIPHERY_SPI_DISPLAY_X86
+
+#if defined(PERIPHERY_SPI_DISPLAY_NEON)
+
+static std::size_t rgb888_neon(const uint8_t* src, uint8_t* dst, std::size_t n)
+{
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        uint8x16x3_t rgb = vld3q_u8(src + i * 3);
+        uint8x16x2_t out;
+        out.val[0] = vorrq_u8(vandq_u8(rgb.val[0], vdupq_n_u8(0xF8)), vshrq_n_u8(rgb.val[1], 5));
+        out.val[1] = vorrq_u8(vandq_u8(vshlq_n_u8(rgb.val[1], 3), vdupq_n_u8(0xE0)), vshrq_n_u8(rgb.val[2], 3));
+        vst2q_u8(dst + i * 2, out);
+    }
+    return i;
+}
+
+static std::size_t rgb565_neon(const uint8_t* src, uint8_t* dst, std::size_t n)
+{
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        vst1q_u8(dst + i * 2, vrev16q_u8(vld1q_u8(src + i * 2)));
+    }
+    return i;
+}
+
+#endif // PERIPHERY_SPI_DISPLAY_NEON
+
+// ... same implementation choice as the SPI word packing ...
+static void convert_row(SpiDisplay::SourceFormat format, const uint8_t* src, uint8_t* dst, std::size_t n)
+{
+    std::size_t done = 0;
+    SpiPackIsa isa = spi_pack_isa();
+#if defined(PERIPHERY_SPI_DISPLAY_X86)
+    if (isa == SpiPackIsa::Sse41 || isa == SpiPackIsa::Avx2) {
+        done = format == SpiDisplay::SourceFormat::Rgb888 ? rgb888_sse41(src, dst, n) : rgb565_sse41(src, dst, n);
+    }
+#elif defined(PERIPHERY_SPI_DISPLAY_NEON)
+    if (isa == SpiPackIsa::Neon) {
+        done = format == SpiDisplay::SourceFormat::Rgb888 ? rgb888_neon(src, dst, n) : rgb565_neon(src, dst, n);
+    }
+#endif
+    (void)isa;
+    if (format == SpiDisplay::SourceFormat::Rgb888) {
+        rgb888_scalar(src + done * 3, dst + done * 2, n - done);
+    } else {
+        rgb565_scalar(src + done * 2, dst + done * 2, n - done);
+    }
+}
+
+
+SpiDisplay::SpiDisplay(std::shared_ptr<Spi> spi, std::shared_ptr<GpioPin> dc, uint16_t width, uint16_t height,
+                       SourceFormat format)
+    : m_spi(spi), m_dc(dc), m_width(width), m_height(height), m_format(format),
+      m_bpp(format == SourceFormat::Rgb888 ? 3 : 2), m_offset_x(0), m_offset_y(0),
+      m_source(static_cast<std::size_t>(width) * height * m_bpp),
+      m_tx_busy(), m_stop(false), m_dc_level(-1), m_window(Rect{ 0, 0, 0, 0 }),
+      m_frames(0), m_windows(0), m_pixel_bytes(0)
+{
+    if (width == 0 || height == 0) {
+        throw std::invalid_argument("SPI display size must not be zero");
+    }
+    for (auto& tx : m_tx) {
+        tx.resize(static_cast<std::size_t>(width) * height * 2);
+    }
+    m_dirty.reserve(4 * max_windows);
+    m_thread = std::thread(&SpiDisplay::run, this);
+}
+
+
+SpiDisplay::~SpiDisplay()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cv.notify_all();
+    m_thread.join();
+}
+
+
+void SpiDisplay::offset(uint16_t x, uint16_t y)
+{
+    wait_idle();
+    m_offset_x = x;
+    m_offset_y = y;
+    m_window = Rect{ 0, 0, 0, 0 };
+}
+
+
+void SpiDisplay::mark_dirty(Rect rect)
+{
+    // ... clip ...
+    if (rect.x >= m_width || rect.y >= m_height || rect.w == 0 || rect.h == 0) {
+        return;
+    }
+    rect.w = static_cast<uint16_t>(std::min<uint32_t>(rect.w, m_width - rect.x));
+    rect.h = static_cast<uint16_t>(std::min<uint32_t>(rect.h, m_height - rect.y));
+
+    m_dirty.push_back(rect);
+    if (m_dirty.size() >= 4 * max_windows) {
+        merge_rects(m_dirty, static_cast<uint32_t>(m_width) * m_height);
+    }
+}
+
+
+void SpiDisplay::present()
+{
+    if (m_dirty.empty()) {
+        return;
+    }
+    merge_rects(m_dirty, static_cast<uint32_t>(m_width) * m_height);
+
+    // ... wait for a free transmit buffer ...
+    std::size_t index;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait(lock, [this] { return !m_tx_busy[0] || !m_tx_busy[1] || m_error; });
+        rethrow();
+        index = m_tx_busy[0] ? 1 : 0;
+        m_tx_busy[index] = true;
+    }
+
+    // ... convert on the rendering thread, the windows are stored back to back ...
+    Frame frame;
+    frame.index = index;
+    frame.rects = m_dirty;
+    uint8_t* dst = m_tx[index].data();
+    for (auto& rect : frame.rects) {
+        assert(dst + area(rect) * 2 <= m_tx[index].data() + m_tx[index].size());
+        convert(rect, dst);
+        dst += area(rect) * 2;
+    }
+    m_dirty.clear();
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.push_back(std::move(frame));
+    }
+    m_cv.notify_all();
+}
+
+
+void SpiDisplay::wait_idle()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cv.wait(lock, [this] { return (!m_tx_busy[0] && !m_tx_busy[1]) || m_error; });
+    rethrow();
+}
+
+
+void SpiDisplay::command(uint8_t cmd, const_buffer params)
+{
+    wait_idle();
+    send(false, &cmd, 1);
+    if (params.size() > 0) {
+        send(true, static_cast<const uint8_t*>(params.data()), params.size());
+    }
+    // ... the command may have moved the window (or be CASET / RASET itself) ...
+    m_window = Rect{ 0, 0, 0, 0 };
+}
+
+
+void SpiDisplay::rethrow()
+{
+    if (m_error) {
+        auto e = m_error;
+        m_error = nullptr;
+        std::rethrow_exception(e);
+    }
+}
+
+
+void SpiDisplay::convert(const Rect& rect, uint8_t* dst) const
+{
+    const uint8_t* src = m_source.data() + (static_cast<std::size_t>(rect.y) * m_width + rect.x) * m_bpp;
+    for (uint16_t row = 0; row < rect.h; row++) {
+        convert_row(m_format, src, dst, rect.w);
+        src += stride();
+        dst += static_cast<std::size_t>(rect.w) * 2;
+    }
+}
+
+
+void SpiDisplay::send(bool data, const uint8_t* bytes, std::size_t len)
+{
+    int level = data ? 1 : 0;
+    if (level != m_dc_level) {
+        m_dc->set(data ? GpioPin::State::High : GpioPin::State::Low);
+        m_dc_level = level;
+    }
+    m_spi->transfer(bytes, nullptr, len);
+}
+
+
+void SpiDisplay::send_window(const Rect& rect, const uint8_t* pixels)
+{
+    uint16_t x0 = static_cast<uint16_t>(rect.x + m_offset_x);
+    uint16_t x1 = static_cast<uint16_t>(x0 + rect.w - 1);
+    uint16_t y0 = static_cast<uint16_t>(rect.y + m_offset_y);
+    uint16_t y1 = static_cast<uint16_t>(y0 + rect.h - 1);
+
+    if (m_window.w == 0 || rect.x != m_window.x || rect.w != m_window.w) {
+        const uint8_t caset[4] = { static_cast<uint8_t>(x0 >> 8), static_cast<uint8_t>(x0),
+                                   static_cast<uint8_t>(x1 >> 8), static_cast<uint8_t>(x1) };
+        send(false, &dcs_caset, 1);
+        send(true, caset, sizeof(caset));
+    }
+    if (m_window.h == 0 || rect.y != m_window.y || rect.h != m_window.h) {
+        const uint8_t raset[4] = { static_cast<uint8_t>(y0 >> 8), static_cast<uint8_t>(y0),
+                                   static_cast<uint8_t>(y1 >> 8), static_cast<uint8_t>(y1) };
+        send(false, &dcs_raset, 1);
+        send(true, raset, sizeof(raset));
+    }
+    m_window = rect;
+
+    // ... pixel data, chunked at spidev bufsiz with CS held ...
+    send(false, &dcs_ramwr, 1);
+    send(true, pixels, area(rect) * 2);
+}
+
+
+void SpiDisplay::run()
+{
+    for (;;) {
+        Frame frame;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+            if (m_queue.empty()) {
+                return;
+            }
+            frame = std::move(m_queue.front());
+            m_queue.pop_front();
+        }
+
+        uint64_t bytes = 0;
+        std::exception_ptr error;
+        try {
+            const uint8_t* pixels = m_tx[frame.index].data();
+            for (auto& rect : frame.rects) {
+                send_window(rect, pixels);
+                pixels += area(rect) * 2;
+                bytes += area(rect) * 2;
+            }
+        } catch (...) {
+            error = std::current_exception();
+            m_window = Rect{ 0, 0, 0, 0 };
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_tx_busy[frame.index] = false;
+            m_frames++;
+            m_windows += frame.rects.size();
+            m_pixel_bytes += bytes;
+            if (error && !m_error) {
+                m_error = error;
+            }
+        }
+        m_cv.notify_all();
+    }
+}
+
+
+uint64_t SpiDisplay::frames() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_frames;
+}
+
+
+uint64_t SpiDisplay::windows() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_windows;
+}
+
+
+uint64_t SpiDisplay::pixel_bytes() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_pixel_bytes;
+}
+
+
+} // ... namespace periphery ...
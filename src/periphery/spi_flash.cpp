@@ -0,0 +1,622 @@
+/*
+ * cpp-periphery
+ * https://github.com/mpb27/cpp-periphery
+ * License: MIT
+ *
+ */
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <stdexcept>
+
+#include "periphery/spi_flash.hpp"
+
+namespace periphery {
+
+// ... opcodes ...
+static constexpr uint8_t op_wren  = 0x06;
+static constexpr uint8_t op_wrdi  = 0x04;
+static constexpr uint8_t op_rdsr  = 0x05;
+static constexpr uint8_t op_wrsr  = 0x01;
+static constexpr uint8_t op_en4b  = 0xB7;
+static constexpr uint8_t op_clsr  = 0x30;     // ... Spansion / Infineon clear status ...
+static constexpr uint8_t op_rdfsr = 0x70;     // ... Micron flag status ...
+static constexpr uint8_t op_clfsr = 0x50;
+static constexpr uint8_t op_rdscur = 0x2B;    // ... Macronix security register ...
+static constexpr uint8_t op_rdid  = 0x9F;
+static constexpr uint8_t op_rdsfdp = 0x5A;
+static constexpr uint8_t op_ce    = 0xC7;
+static constexpr uint8_t status_wip = 0x01;
+static constexpr uint8_t status_wel = 0x02;
+
+// ... RDSR polls appended to a program / erase message ...
+static constexpr std::size_t poll_count = 16;
+
+static uint32_t le32(const uint8_t* p)
+{
+    return static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8
+         | static_cast<uint32_t>(p[2]) << 16 | static_cast<uint32_t>(p[3]) << 24;
+}
+
+// ... SFDP fast read field, dummy and mode clocks turned into bytes on the address lines, false
+//     when they do not add up to whole bytes ...
+static bool sfdp_read_command(uint32_t field, Spi::BusWidth address_width, uint8_t& opcode, unsigned& dummy_bytes)
+{
+    unsigned clocks = (field & 0x1F) + ((field >> 5) & 0x07);
+    unsigned bits = clocks * static_cast<unsigned>(address_width);
+    opcode = static_cast<uint8_t>(field >> 8);
+    dummy_bytes = bits / 8;
+    return opcode != 0 && bits % 8 == 0;
+}
+
+
+SpiFlash::SpiFlash(std::shared_ptr<Spi> spi, ReadMode mode)
+    : m_spi(spi), m_info(), m_mode(ReadMode::Fast), m_read(), m_4bait(0), m_erase4_opcode(0),
+      m_4byte_entry(0x01), m_4byte_only(false), m_4byte_opcodes(false), m_quad_enabled(false), m_fail_mask(0)
+{
+    // ... defaults, replaced by SFDP values when present ...
+    m_sfdp_read[0] = ReadCommand{ 0x3B, 1, Spi::BusWidth::Single, Spi::BusWidth::Dual };
+    m_sfdp_read[1] = ReadCommand{ 0x6B, 1, Spi::BusWidth::Single, Spi::BusWidth::Quad };
+    m_sfdp_read[2] = ReadCommand{ 0xEB, 3, Spi::BusWidth::Quad, Spi::BusWidth::Quad };
+
+    identify();
+    read_mode(mode);
+}
+
+
+void SpiFlash::identify()
+{
+    std::array<uint8_t, 4> tx = {{op_rdid, 0, 0, 0}};
+    std::array<uint8_t, 4> rx;
+    m_spi->transfer({ Spi::Segment::transfer(buffer(tx), buffer(rx)) });
+
+    if (rx[1] == 0x00 || rx[1] == 0xFF) {
+        throw std::runtime_error("no SPI flash responding to JEDEC ID");
+    }
+
+    m_info.manufacturer = rx[1];
+    m_info.device = static_cast<uint16_t>(rx[2] << 8 | rx[3]);
+    // ... capacity code n is 2^n bytes, after 0x19 (32 MiB) Micron, Winbond, ... continue with 0x20 for
+    //     64 MiB up to 0x22 for 256 MiB while Macronix uses 0x1A - 0x1C ...
+    if (rx[3] >= 0x10 && rx[3] <= 0x1F) {
+        m_info.size = 1ULL << rx[3];
+    } else if (rx[3] >= 0x20 && rx[3] <= 0x22) {
+        m_info.size = 1ULL << (rx[3] - 0x20 + 26);
+    } else {
+        m_info.size = 0;
+    }
+    m_info.page_size = 256;
+    m_info.sector_size = 4096;
+    m_info.sector_erase_opcode = 0x20;
+    m_info.dual_output = true;
+    m_info.quad_output = true;
+    m_info.quad_io = true;
+    m_info.quad_enable = quad_enable_unknown;
+    m_info.sfdp = read_sfdp();
+
+    if (m_info.size == 0) {
+        throw std::runtime_error("SPI flash size unknown, no SFDP and unrecognized JEDEC ID");
+    }
+    if (m_info.address_bytes == 0) {
+        m_info.address_bytes = m_info.size > (1ULL << 24) ? 4 : 3;
+    }
+
+    // ... Spansion / Infineon leave WIP set and flag the failure in SR1 ...
+    if (m_info.manufacturer == 0x01 || m_info.manufacturer == 0x34) {
+        m_fail_mask = 0x60;
+    }
+
+    setup_addressing();
+}
+
+
+void SpiFlash::setup_addressing()
+{
+    if (m_info.address_bytes == 3) {
+        return;
+    }
+
+    // ... stateless when the 4 byte address instruction table has 0x13, 0x0C, 0x12 and the sector erase ...
+    const uint32_t needed = 0x01 | 0x02 | 0x40;
+    if ((m_4bait & needed) == needed && m_erase4_opcode != 0) {
+        m_4byte_opcodes = true;
+        return;
+    }
+    if (m_4byte_only) {
+        return;
+    }
+
+    // ... EN4B, the 3 byte opcodes then take 4 address bytes ...
+    if (m_4byte_entry & 0x01) {
+        command(op_en4b);
+    } else if (m_4byte_entry & 0x02) {
+        command(op_wren);
+        command(op_en4b);
+    } else {
+        throw std::runtime_error("SPI flash has no supported way into 4 byte address mode");
+    }
+}
+
+
+void SpiFlash::sfdp_read(uint32_t address, mutable_buffer data) const
+{
+    // ... SFDP is always 3 byte addressed with 8 dummy clocks ...
+    std::array<uint8_t, 5> cmd = {{op_rdsfdp, static_cast<uint8_t>(address >> 16), static_cast<uint8_t>(address >> 8),
+                                   static_cast<uint8_t>(address), 0}};
+    m_spi->transfer({ Spi::Segment::write(buffer(cmd)), Spi::Segment::read(data) });
+}
+
+
+bool SpiFlash::read_sfdp()
+{
+    std::array<uint8_t, 16> header;
+    sfdp_read(0, buffer(header));
+    if (le32(&header[0]) != 0x50444653) {   // ... "SFDP" ...
+        return false;
+    }
+
+    // ... parameter headers follow the SFDP header, look for the basic flash parameter table and
+    //     the 4 byte address instruction table ...
+    uint32_t bfpt = 0, bfpt_dwords = 0;
+    uint32_t fbait = 0, fbait_dwords = 0;
+    unsigned headers = header[6] + 1u;
+    for (unsigned i = 0; i < headers; i++) {
+        std::array<uint8_t, 8> param;
+        sfdp_read(8 + 8 * i, buffer(param));
+        uint16_t id = static_cast<uint16_t>(param[7] << 8 | param[0]);
+        if (id == 0xFF00 && bfpt_dwords == 0) {
+            bfpt = le32(&param[4]) & 0xFFFFFF;
+            bfpt_dwords = param[3];
+        } else if (id == 0xFF84) {
+            fbait = le32(&param[4]) & 0xFFFFFF;
+            fbait_dwords = param[3];
+        }
+    }
+    if (bfpt_dwords == 0) {
+        return false;
+    }
+
+    std::array<uint8_t, 64> table;
+    table.fill(0);
+    std::size_t dwords = std::min<std::size_t>(bfpt_dwords, table.size() / 4);
+    sfdp_read(bfpt, mutable_buffer(table.data(), dwords * 4));
+
+    uint32_t dw1 = le32(&table[0]);
+    uint32_t dw2 = le32(&table[4]);
+    uint32_t dw3 = le32(&table[8]);
+    uint32_t dw4 = le32(&table[12]);
+
+    m_info.size = (dw2 & 0x80000000u) ? (1ULL << (dw2 & 0x7FFFFFFFu)) / 8 : (static_cast<uint64_t>(dw2) + 1) / 8;
+    if (((dw1 >> 17) & 0x03) == 0x02) {
+        m_info.address_bytes = 4;   // ... 4 byte addressing only ...
+        m_4byte_only = true;
+    }
+    if ((dw1 & 0x03) == 0x01) {
+        m_info.sector_size = 4096;
+        m_info.sector_erase_opcode = static_cast<uint8_t>(dw1 >> 8);
+    }
+
+    uint8_t opcode;
+    unsigned dummy;
+    m_info.dual_output = (dw1 & (1u << 16)) != 0
+        && sfdp_read_command(dw4, Spi::BusWidth::Single, opcode, dummy);
+    if (m_info.dual_output) {
+        m_sfdp_read[0] = ReadCommand{ opcode, dummy, Spi::BusWidth::Single, Spi::BusWidth::Dual };
+    }
+    m_info.quad_output = (dw1 & (1u << 22)) != 0
+        && sfdp_read_command(dw3 >> 16, Spi::BusWidth::Single, opcode, dummy);
+    if (m_info.quad_output) {
+        m_sfdp_read[1] = ReadCommand{ opcode, dummy, Spi::BusWidth::Single, Spi::BusWidth::Quad };
+    }
+    m_info.quad_io = (dw1 & (1u << 21)) != 0
+        && sfdp_read_command(dw3, Spi::BusWidth::Quad, opcode, dummy);
+    if (m_info.quad_io) {
+        m_sfdp_read[2] = ReadCommand{ opcode, dummy, Spi::BusWidth::Quad, Spi::BusWidth::Quad };
+    }
+
+    // ... page size is in DWORD 11 of JESD216B and later tables ...
+    if (dwords >= 11) {
+        unsigned n = (le32(&table[40]) >> 4) & 0x0F;
+        if (n != 0) {
+            m_info.page_size = 1u << n;
+        }
+    }
+    // ... quad enable requirements (QER) in DWORD 15, 4 byte address entry methods in DWORD 16 ...
+    if (dwords >= 15) {
+        uint8_t qer = static_cast<uint8_t>((le32(&table[56]) >> 20) & 0x07);
+        m_info.quad_enable = qer <= 6 ? qer : quad_enable_unknown;
+    }
+    if (dwords >= 16) {
+        m_4byte_entry = static_cast<uint8_t>(le32(&table[60]) >> 24);
+    }
+
+    // ... 4 byte opcode of the sector erase, from the erase type (DWORD 8 / 9) that is 4 KiB ...
+    if (fbait_dwords >= 2 && dwords >= 9) {
+        std::array<uint8_t, 8> fb;
+        sfdp_read(fbait, buffer(fb));
+        m_4bait = le32(&fb[0]);
+        for (unsigned type = 0; type < 4; type++) {
+            uint32_t dw = le32(&table[28 + 4 * (type / 2)]) >> (16 * (type % 2));
+            bool sector = (dw & 0xFF) == 12 && static_cast<uint8_t>(dw >> 8) == m_info.sector_erase_opcode;
+            if (sector && (m_4bait & (1u << (9 + type)))) {
+                m_erase4_opcode = fb[4 + type];
+            }
+        }
+    }
+    return true;
+}
+
+
+void SpiFlash::read_mode(ReadMode mode)
+{
+    auto wide_enough = [](Spi::BusWidth have, Spi::BusWidth need) {
+        return static_cast<int>(have) >= static_cast<int>(need);
+    };
+
+    ReadCommand cmd;
+    switch (mode) {
+        case ReadMode::Slow:       cmd = ReadCommand{ opcode4(0x03, 0x13), 0, Spi::BusWidth::Single, Spi::BusWidth::Single }; break;
+        case ReadMode::Fast:       cmd = ReadCommand{ opcode4(0x0B, 0x0C), 1, Spi::BusWidth::Single, Spi::BusWidth::Single }; break;
+        case ReadMode::DualOutput: cmd = m_sfdp_read[0]; break;
+        case ReadMode::QuadOutput: cmd = m_sfdp_read[1]; break;
+        case ReadMode::QuadIO:     cmd = m_sfdp_read[2]; break;
+    }
+
+    bool part = mode == ReadMode::DualOutput ? m_info.dual_output
+              : mode == ReadMode::QuadOutput ? m_info.quad_output
+              : mode == ReadMode::QuadIO     ? m_info.quad_io
+              : true;
+    if (!part) {
+        throw std::invalid_argument("SPI flash does not support this read mode");
+    }
+    if (!wide_enough(m_spi->rx_bus_width(), cmd.data_width) || !wide_enough(m_spi->tx_bus_width(), cmd.address_width)) {
+        throw std::invalid_argument("SPI controller bus width too narrow for this read mode");
+    }
+
+    // ... 4 byte variants of the SFDP (3 byte) opcodes, as listed in the 4 byte instruction table ...
+    if (m_4byte_opcodes) {
+        unsigned bit = 0;
+        switch (mode) {
+            case ReadMode::Slow:       bit = 0; break;
+            case ReadMode::Fast:       bit = 1; break;
+            case ReadMode::DualOutput: bit = 2; cmd.opcode = 0x3C; break;
+            case ReadMode::QuadOutput: bit = 4; cmd.opcode = 0x6C; break;
+            case ReadMode::QuadIO:     bit = 5; cmd.opcode = 0xEC; break;
+        }
+        if ((m_4bait & (1u << bit)) == 0) {
+            throw std::invalid_argument("SPI flash has no 4 byte opcode for this read mode");
+        }
+    }
+
+    // ... IO2 / IO3 are /WP and /HOLD until QE is set ...
+    if ((mode == ReadMode::QuadOutput || mode == ReadMode::QuadIO) && !m_quad_enabled) {
+        enable_quad();
+        m_quad_enabled = true;
+    }
+
+    m_mode = mode;
+    m_read = cmd;
+}
+
+
+std::size_t SpiFlash::encode_address(uint8_t* dst, uint64_t address) const
+{
+    for (unsigned i = 0; i < m_info.address_bytes; i++) {
+        dst[i] = static_cast<uint8_t>(address >> (8 * (m_info.address_bytes - 1 - i)));
+    }
+    return m_info.address_bytes;
+}
+
+
+void SpiFlash::read(uint64_t address, mutable_buffer data) const
+{
+    if (address + data.size() > m_info.size) {
+        throw std::out_of_range("SPI flash read past the end");
+    }
+
+    // ... opcode, address, then mode byte (0xFF, never continuous read) and dummy bytes ...
+    std::array<uint8_t, 16> header;
+    header.fill(0xFF);
+    std::size_t header_len = 1 + m_info.address_bytes + m_read.dummy_bytes;
+    std::size_t chunk = Spi::max_transfer_size() - header_len;
+
+    uint8_t* out = static_cast<uint8_t*>(data.data());
+    std::size_t remaining = data.size();
+
+    Spi::Plan<3> plan;
+    while (remaining > 0) {
+        std::size_t n = std::min(chunk, remaining);
+        header[0] = m_read.opcode;
+        encode_address(&header[1], address);
+
+        plan.clear();
+        if (m_read.address_width == Spi::BusWidth::Single) {
+            plan.write(const_buffer(header.data(), header_len));
+        } else {
+            plan.write(const_buffer(header.data(), 1));
+            plan.write(const_buffer(header.data() + 1, header_len - 1));
+            plan.back().tx_width(m_read.address_width);
+        }
+        plan.read(mutable_buffer(out, n));
+        plan.back().rx_width(m_read.data_width);
+        m_spi->transfer(plan);
+
+        address += n;
+        out += n;
+        remaining -= n;
+    }
+}
+
+
+void SpiFlash::enable_quad()
+{
+    uint8_t sr1, sr2;
+    switch (m_info.quad_enable) {
+        case 0:
+            // ... no QE bit, quad commands always work ...
+            return;
+        case 1:
+        case 4: {
+            // ... QE is SR2 bit 1, written as the second WRSR byte. JESD216 defines no SR2 read for
+            //     these, the parts using them (Spansion CR1, older Winbond / GigaDevice) answer 0x35,
+            //     skip the non volatile write when QE already reads set and keep the other bits
+            //     (CMP, SRP1, LB, ...). A part that does not answer reads 0xFF, then only QE can
+            //     be written and the other SR2 bits end up 0 ...
+            sr2 = read_register(0x35);
+            const bool readable = sr2 != 0xFF;
+            if (readable && (sr2 & 0x02)) {
+                return;
+            }
+            sr1 = status();
+            const uint8_t wrsr[3] = { op_wrsr, sr1, static_cast<uint8_t>(readable ? sr2 | 0x02 : 0x02) };
+            write_register(wrsr, sizeof(wrsr));
+            if (!readable) {
+                return;
+            }
+            sr2 = static_cast<uint8_t>(read_register(0x35) & 0x02);
+            break;
+        }
+        case 2: {
+            sr1 = status();
+            if (sr1 & 0x40) {
+                return;
+            }
+            const uint8_t wrsr[2] = { op_wrsr, static_cast<uint8_t>(sr1 | 0x40) };
+            write_register(wrsr, sizeof(wrsr));
+            sr2 = static_cast<uint8_t>(status() & 0x40);
+            break;
+        }
+        case 3: {
+            sr2 = read_register(0x3F);
+            if (sr2 & 0x80) {
+                return;
+            }
+            const uint8_t wrsr2[2] = { 0x3E, static_cast<uint8_t>(sr2 | 0x80) };
+            write_register(wrsr2, sizeof(wrsr2));
+            sr2 = static_cast<uint8_t>(read_register(0x3F) & 0x80);
+            break;
+        }
+        case 5: {
+            sr2 = read_register(0x35);
+            if (sr2 & 0x02) {
+                return;
+            }
+            sr1 = status();
+            const uint8_t wrsr[3] = { op_wrsr, sr1, static_cast<uint8_t>(sr2 | 0x02) };
+            write_register(wrsr, sizeof(wrsr));
+            sr2 = static_cast<uint8_t>(read_register(0x35) & 0x02);
+            break;
+        }
+        case 6: {
+            sr2 = read_register(0x35);
+            if (sr2 & 0x02) {
+                return;
+            }
+            const uint8_t wrsr2[2] = { 0x31, static_cast<uint8_t>(sr2 | 0x02) };
+            write_register(wrsr2, sizeof(wrsr2));
+            sr2 = static_cast<uint8_t>(read_register(0x35) & 0x02);
+            break;
+        }
+        default:
+            throw std::invalid_argument("SPI flash quad enable method unknown (no SFDP QER)");
+    }
+    if (sr2 == 0) {
+        throw std::runtime_error("SPI flash quad enable bit did not set");
+    }
+}
+
+
+uint8_t SpiFlash::read_register(uint8_t opcode) const
+{
+    std::array<uint8_t, 2> tx = {{opcode, 0}};
+    std::array<uint8_t, 2> rx;
+    m_spi->transfer({ Spi::Segment::transfer(buffer(tx), buffer(rx)) });
+    return rx[1];
+}
+
+
+void SpiFlash::command(uint8_t opcode) const
+{
+    const std::array<uint8_t, 1> cmd = {{opcode}};
+    m_spi->transfer({ Spi::Segment::write(buffer(cmd)) });
+}
+
+
+void SpiFlash::write_register(const uint8_t* bytes, std::size_t len)
+{
+    // ... non volatile status writes take up to ~15 ms ...
+    Spi::Segment segment = Spi::Segment::write(const_buffer(bytes, len));
+    write_and_poll(&segment, 1, 1000, std::chrono::milliseconds(200));
+}
+
+
+uint8_t SpiFlash::status() const
+{
+    return read_register(op_rdsr);
+}
+
+
+void SpiFlash::wait_ready(std::chrono::milliseconds timeout) const
+{
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (busy()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            throw timeout_exception();
+        }
+    }
+}
+
+
+void SpiFlash::write_and_poll(const Spi::Segment* segments, std::size_t count, uint16_t poll_delay_us,
+                              std::chrono::milliseconds timeout)
+{
+    // ... WREN, RDSR for the write enable latch, the command segments, then RDSR polls each followed
+    //     by a delay, CS toggles between all of them, the part starts working when CS goes up after
+    //     the command ...
+    static const std::array<uint8_t, 1> wren = {{op_wren}};
+    static const std::array<uint8_t, 2> rdsr = {{op_rdsr, 0}};
+    std::array<uint8_t, 2> wel;
+    std::array<std::array<uint8_t, 2>, poll_count> polls;
+
+    Spi::Plan<5 + poll_count> plan;
+    plan.write(buffer(wren));
+    plan.back().cs_change(true);
+    plan.transfer(buffer(rdsr), buffer(wel));
+    plan.back().cs_change(true);
+    for (std::size_t i = 0; i < count; i++) {
+        plan.add(segments[i]);
+    }
+    plan.back().cs_change(true);
+    for (std::size_t i = 0; i < poll_count; i++) {
+        plan.transfer(buffer(rdsr), buffer(polls[i]));
+        plan.back().delay_usecs(poll_delay_us).cs_change(i + 1 < poll_count);
+    }
+    m_spi->transfer(plan);
+
+    if ((wel[1] & status_wel) == 0) {
+        throw std::runtime_error("SPI flash write enable not latched");
+    }
+
+    // ... true once done, failures flagged in the status register stop the polling ...
+    auto done = [this](uint8_t status) {
+        if ((status & m_fail_mask) != 0 || (status & status_wip) == 0) {
+            check_result(status);
+            return true;
+        }
+        return false;
+    };
+
+    for (auto& poll : polls) {
+        if (done(poll[1])) {
+            return;
+        }
+    }
+
+    // ... still busy, keep polling with the poll train alone ...
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    Spi::Plan<poll_count> train;
+    for (std::size_t i = 0; i < poll_count; i++) {
+        train.transfer(buffer(rdsr), buffer(polls[i]));
+        train.back().delay_usecs(poll_delay_us).cs_change(i + 1 < poll_count);
+    }
+    for (;;) {
+        m_spi->transfer(train);
+        for (auto& poll : polls) {
+            if (done(poll[1])) {
+                return;
+            }
+        }
+        if (std::chrono::steady_clock::now() > deadline) {
+            throw timeout_exception();
+        }
+    }
+}
+
+
+void SpiFlash::check_result(uint8_t status) const
+{
+    if ((status & m_fail_mask) != 0) {
+        command(op_clsr);
+        command(op_wrdi);
+        throw std::runtime_error("SPI flash program / erase failed");
+    }
+    // ... a command the part refused (protected area) never clears the latch ...
+    if ((status & status_wel) != 0) {
+        command(op_wrdi);
+        throw std::runtime_error("SPI flash ignored the command, area protected?");
+    }
+    if (m_info.manufacturer == 0x20) {
+        uint8_t flags = read_register(op_rdfsr);
+        if ((flags & 0x32) != 0) {     // ... erase, program, protection error ...
+            command(op_clfsr);
+            throw std::runtime_error("SPI flash program / erase failed");
+        }
+    } else if (m_info.manufacturer == 0xC2) {
+        if ((read_register(op_rdscur) & 0x60) != 0) {   // ... E_FAIL, P_FAIL ...
+            throw std::runtime_error("SPI flash program / erase failed");
+        }
+    }
+}
+
+
+void SpiFlash::program(uint64_t address, const_buffer data)
+{
+    if (address + data.size() > m_info.size) {
+        throw std::out_of_range("SPI flash program past the end");
+    }
+
+    const uint8_t* in = static_cast<const uint8_t*>(data.data());
+    std::size_t remaining = data.size();
+    std::array<uint8_t, 5> cmd;
+
+    while (remaining > 0) {
+        std::size_t n = std::min<std::size_t>(remaining, m_info.page_size - address % m_info.page_size);
+        cmd[0] = opcode4(0x02, 0x12);
+        std::size_t cmd_len = 1 + encode_address(&cmd[1], address);
+
+        // ... a page programs in well under a millisecond, poll every 50 us ...
+        Spi::Segment segments[2] = { Spi::Segment::write(const_buffer(cmd.data(), cmd_len)),
+                                     Spi::Segment::write(const_buffer(in, n)) };
+        write_and_poll(segments, 2, 50, std::chrono::milliseconds(50));
+
+        address += n;
+        in += n;
+        remaining -= n;
+    }
+}
+
+
+void SpiFlash::erase_sector(uint64_t address)
+{
+    if (address % m_info.sector_size != 0 || address >= m_info.size) {
+        throw std::invalid_argument("SPI flash sector address not aligned or out of range");
+    }
+
+    std::array<uint8_t, 5> cmd;
+    cmd[0] = m_4byte_opcodes ? m_erase4_opcode : m_info.sector_erase_opcode;
+    std::size_t cmd_len = 1 + encode_address(&cmd[1], address);
+
+    // ... sector erase takes tens of milliseconds, poll every 2 ms ...
+    Spi::Segment segment = Spi::Segment::write(const_buffer(cmd.data(), cmd_len));
+    write_and_poll(&segment, 1, 2000, std::chrono::milliseconds(2000));
+}
+
+
+void SpiFlash::erase(uint64_t address, std::size_t len)
+{
+    for (uint64_t end = address + len; address < end; address += m_info.sector_size) {
+        erase_sector(address);
+    }
+}
+
+
+void SpiFlash::erase_chip()
+{
+    static const std::array<uint8_t, 1> cmd = {{op_ce}};
+    Spi::Segment segment = Spi::Segment::write(buffer(cmd));
+    write_and_poll(&segment, 1, 60000, std::chrono::milliseconds(400000));
+}
+
+
+} // ... namespace periphery ...
@@ -0,0 +1,661 @@
+/*
+ * cpp-periphery
+ * https://github.com/mpb27/cpp-periphery
+ * License: MIT
+ *
+ * Notes:
+ *   1) SIMD unpack works on groups of 8 words, bits bytes each, so every group starts on a byte.
+ *      Each word is gathered into a 32 bit lane with a byte shuffle (4 bytes are enough up to
+ *      25 bits), shifted left per lane so its top bit lands on bit 31, and then shifted right by
+ *      32 - bits, logical or arithmetic. The two halves of a group are loaded separately so that
+ *      every shuffle index stays within its 16 byte load.
+ *   2) SIMD pack covers 12 bit (pairs of words combined in 64 bit lanes) and 24 bit words, both
+ *      end up as a byte shuffle. Other even sizes from 8 to 22 bits take groups of 4 words, which
+ *      end on a byte: each word is shifted to its bit position in its own 32 bit lane, then the
+ *      even and the odd lanes are byte shuffled to their output bytes and or-ed, words of 8 bits
+ *      or more never share a byte with the word after the next one.
+ *   3) SIMD loops stop early enough that their 16 byte loads / stores stay inside the buffers, the
+ *      scalar code finishes the rest.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PERIPHERY_SPI_PACK_X86 1
+#elif defined(__aarch64__) && defined(PERIPHERY_NEON)
+#include <arm_neon.h>
+#define PERIPHERY_SPI_PACK_NEON 1
+#endif
+
+#include "periphery/spi_pack.hpp"
+
+namespace periphery {
+
+namespace {
+
+// ... scalar, any word size ...
+
+template <typename T>
+void unpack_scalar(const uint8_t* src, T* dst, std::size_t count, unsigned bits, WordEndian endian, bool is_signed)
+{
+    const uint64_t mask = (1ULL << bits) - 1;
+    const uint32_t sign = is_signed ? static_cast<uint32_t>(1ULL << (bits - 1)) : 0;
+    uint64_t acc = 0;
+    unsigned nbits = 0;
+
+    for (std::size_t i = 0; i < count; i++) {
+        uint32_t v;
+        if (endian == WordEndian::Big) {
+            while (nbits < bits) {
+                acc = (acc << 8) | *src++;
+                nbits += 8;
+            }
+            nbits -= bits;
+            v = static_cast<uint32_t>((acc >> nbits) & mask);
+        } else {
+            while (nbits < bits) {
+                acc |= static_cast<uint64_t>(*src++) << nbits;
+                nbits += 8;
+            }
+            v = static_cast<uint32_t>(acc & mask);
+            acc >>= bits;
+            nbits -= bits;
+        }
+        if (v & sign) {
+            v |= ~static_cast<uint32_t>(mask);
+        }
+        dst[i] = static_cast<T>(static_cast<int32_t>(v));
+    }
+}
+
+template <typename T>
+void pack_scalar(const T* src, uint8_t* dst, std::size_t count, unsigned bits, WordEndian endian)
+{
+    const uint64_t mask = (1ULL << bits) - 1;
+    uint64_t acc = 0;
+    unsigned nbits = 0;
+
+    for (std::size_t i = 0; i < count; i++) {
+        uint64_t v = static_cast<uint32_t>(static_cast<int32_t>(src[i])) & mask;
+        if (endian == WordEndian::Big) {
+            acc = (acc << bits) | v;
+            nbits += bits;
+            while (nbits >= 8) {
+                nbits -= 8;
+                *dst++ = static_cast<uint8_t>(acc >> nbits);
+            }
+        } else {
+            acc |= v << nbits;
+            nbits += bits;
+            while (nbits >= 8) {
+                *dst++ = static_cast<uint8_t>(acc);
+                acc >>= 8;
+                nbits -= 8;
+            }
+        }
+    }
+    if (nbits > 0) {
+        *dst = static_cast<uint8_t>(endian == WordEndian::Big ? acc << (8 - nbits) : acc);
+    }
+}
+
+struct ReverseTable {
+    uint8_t value[256];
+    ReverseTable()
+    {
+        for (unsigned i = 0; i < 256; i++) {
+            unsigned r = 0;
+            for (unsigned b = 0; b < 8; b++) {
+                r |= ((i >> b) & 1u) << (7 - b);
+            }
+            value[i] = static_cast<uint8_t>(r);
+        }
+    }
+};
+
+const ReverseTable reverse_table;
+
+void reverse_scalar(const uint8_t* src, uint8_t* dst, std::size_t len)
+{
+    for (std::size_t i = 0; i < len; i++) {
+        dst[i] = reverse_table.value[src[i]];
+    }
+}
+
+// ... shuffle / shift plan for one group of 8 words, see note 1 ...
+
+struct UnpackPlan {
+    uint8_t     shuffle[32];    // ... 16 byte indices per half ...
+    int32_t     shift[8];       // ... left shift per word ...
+    unsigned    right;          // ... 32 - bits ...
+    std::size_t half;           // ... offset of the second half load ...
+};
+
+void make_plan(unsigned bits, WordEndian endian, UnpackPlan& plan)
+{
+    plan.right = 32 - bits;
+    plan.half = (4 * bits) / 8;
+    for (unsigned k = 0; k < 8; k++) {
+        unsigned pos = k * bits;
+        std::size_t rel = pos / 8 - (k < 4 ? 0 : plan.half);
+        unsigned s = pos % 8;
+        for (unsigned j = 0; j < 4; j++) {
+            plan.shuffle[4 * k + j] = static_cast<uint8_t>(endian == WordEndian::Big ? rel + 3 - j : rel + j);
+        }
+        plan.shift[k] = static_cast<int32_t>(endian == WordEndian::Big ? s : 32 - bits - s);
+    }
+}
+
+// ... words the SIMD loops may take, whole groups whose loads stay inside src ...
+std::size_t unpack_groups(std::size_t count, unsigned bits, const UnpackPlan& plan)
+{
+    std::size_t len = spi_packed_size(count, bits);
+    std::size_t groups = count / 8;
+    while (groups > 0 && (groups - 1) * bits + plan.half + 16 > len) {
+        groups--;
+    }
+    return groups;
+}
+
+// ... shift / shuffle plan for packing one group of 4 words, see note 2 ...
+
+struct PackPlan {
+    uint8_t     even[16];       // ... output byte <- byte of lane 0 / 2, 0xFF for none ...
+    uint8_t     odd[16];        // ... output byte <- byte of lane 1 / 3, 0xFF for none ...
+    int32_t     shift[4];       // ... left shift per word ...
+};
+
+void make_pack_plan(unsigned bits, WordEndian endian, PackPlan& plan)
+{
+    std::memset(plan.even, 0xFF, sizeof(plan.even));
+    std::memset(plan.odd, 0xFF, sizeof(plan.odd));
+    for (unsigned k = 0; k < 4; k++) {
+        unsigned pos = k * bits;
+        unsigned rel = pos / 8;
+        unsigned s = pos % 8;
+        unsigned bytes = (s + bits + 7) / 8;
+        uint8_t* shuffle = (k % 2 == 0) ? plan.even : plan.odd;
+        for (unsigned j = 0; j < bytes; j++) {
+            shuffle[rel + j] = static_cast<uint8_t>(4 * k + (endian == WordEndian::Big ? 3 - j : j));
+        }
+        plan.shift[k] = static_cast<int32_t>(endian == WordEndian::Big ? 32 - bits - s : s);
+    }
+}
+
+bool pack_plan_fits(unsigned bits)
+{
+    return bits % 2 == 0 && bits >= 8 && bits <= 22 && bits != 12;
+}
+
+// ... words per group and bytes written per group (16 byte stores) for the pack loops ...
+std::size_t pack_groups(std::size_t count, unsigned bits, std::size_t words)
+{
+    std::size_t len = spi_packed_size(count, bits);
+    std::size_t groups = count / words;
+    std::size_t bytes = words * bits / 8;
+    while (groups > 0 && (groups - 1) * bytes + 16 > len) {
+        groups--;
+    }
+    return groups;
+}
+
+#if defined(PERIPHERY_SPI_PACK_X86)
+
+__attribute__((target("sse4.1")))
+std::size_t unpack_sse41(const uint8_t* src, int32_t* dst32, int16_t* dst16, std::size_t count, unsigned bits,
+                         const UnpackPlan& plan, bool is_signed)
+{
+    const std::size_t groups = unpack_groups(count, bits, plan);
+    const __m128i m0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(plan.shuffle));
+    const __m128i m1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(plan.shuffle + 16));
+    // ... no variable per lane shift before AVX2, multiply by 2^shift instead ...
+    int32_t mul[8];
+    for (unsigned k = 0; k < 8; k++) {
+        mul[k] = static_cast<int32_t>(1u << plan.shift[k]);
+    }
+    const __m128i mul0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mul));
+    const __m128i mul1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mul + 4));
+    const __m128i right = _mm_cvtsi32_si128(static_cast<int>(plan.right));
+
+    for (std::size_t g = 0; g < groups; g++) {
+        const uint8_t* p = src + g * bits;
+        __m128i a = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), m0);
+        __m128i b = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + plan.half)), m1);
+        a = _mm_mullo_epi32(a, mul0);
+        b = _mm_mullo_epi32(b, mul1);
+        if (is_signed) {
+            a = _mm_sra_epi32(a, right);
+            b = _mm_sra_epi32(b, right);
+        } else {
+            a = _mm_srl_epi32(a, right);
+            b = _mm_srl_epi32(b, right);
+        }
+        if (dst16) {
+            __m128i w = is_signed ? _mm_packs_epi32(a, b) : _mm_packus_epi32(a, b);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst16 + 8 * g), w);
+        } else {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst32 + 8 * g), a);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst32 + 8 * g + 4), b);
+        }
+    }
+    return groups * 8;
+}
+
+__attribute__((target("avx2")))
+std::size_t unpack_avx2(const uint8_t* src, int32_t* dst32, int16_t* dst16, std::size_t count, unsigned bits,
+                        const UnpackPlan& plan, bool is_signed)
+{
+    const std::size_t groups = unpack_groups(count, bits, plan);
+    const __m256i mask = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(plan.shuffle));
+    const __m256i shift = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(plan.shift));
+    const __m128i right = _mm_cvtsi32_si128(static_cast<int>(plan.right));
+
+    for (std::size_t g = 0; g < groups; g++) {
+        const uint8_t* p = src + g * bits;
+        __m256i v = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + plan.half)), 1);
+        v = _mm256_sllv_epi32(_mm256_shuffle_epi8(v, mask), shift);
+        v = is_signed ? _mm256_sra_epi32(v, right) : _mm256_srl_epi32(v, right);
+        if (dst16) {
+            __m128i lo = _mm256_castsi256_si128(v);
+            __m128i hi = _mm256_extracti128_si256(v, 1);
+            __m128i w = is_signed ? _mm_packs_epi32(lo, hi) : _mm_packus_epi32(lo, hi);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst16 + 8 * g), w);
+        } else {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst32 + 8 * g), v);
+        }
+    }
+    return groups * 8;
+}
+
+__attribute__((target("sse4.1")))
+std::size_t pack_sse41(const int32_t* src32, const int16_t* src16, uint8_t* dst, std::size_t count, unsigned bits,
+                       WordEndian endian)
+{
+    const bool big = endian == WordEndian::Big;
+
+    if (bits == 12) {
+        // ... 8 words to 12 bytes, word pairs are combined into 24 bits in the low half of each 64 bit lane ...
+        const std::size_t groups = pack_groups(count, 12, 8);
+        const __m128i mask = _mm_set1_epi32(0xFFF);
+        const __m128i sa = big ? _mm_setr_epi8(2, 1, 0, 10, 9, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)
+                               : _mm_setr_epi8(0, 1, 2, 8, 9, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+        const __m128i sb = big ? _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 1, 0, 10, 9, 8, -1, -1, -1, -1)
+                               : _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 0, 1, 2, 8, 9, 10, -1, -1, -1, -1);
+        for (std::size_t g = 0; g < groups; g++) {
+            __m128i a, b;
+            if (src16) {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src16 + 8 * g));
+                a = _mm_cvtepi16_epi32(v);
+                b = _mm_cvtepi16_epi32(_mm_srli_si128(v, 8));
+            } else {
+                a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src32 + 8 * g));
+                b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src32 + 8 * g + 4));
+            }
+            a = _mm_and_si128(a, mask);
+            b = _mm_and_si128(b, mask);
+            if (big) {
+                a = _mm_or_si128(_mm_slli_epi64(a, 12), _mm_srli_epi64(a, 32));
+                b = _mm_or_si128(_mm_slli_epi64(b, 12), _mm_srli_epi64(b, 32));
+            } else {
+                a = _mm_or_si128(a, _mm_srli_epi64(a, 20));
+                b = _mm_or_si128(b, _mm_srli_epi64(b, 20));
+            }
+            __m128i out = _mm_or_si128(_mm_shuffle_epi8(a, sa), _mm_shuffle_epi8(b, sb));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 12 * g), out);
+        }
+        return groups * 8;
+    }
+
+    if (bits == 24 && src32) {
+        // ... 4 words to 12 bytes ...
+        const std::size_t groups = pack_groups(count, 24, 4);
+        const __m128i s = big ? _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1)
+                              : _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+        for (std::size_t g = 0; g < groups; g++) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src32 + 4 * g));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 12 * g), _mm_shuffle_epi8(v, s));
+        }
+        return groups * 4;
+    }
+
+    if (pack_plan_fits(bits)) {
+        // ... 4 words to bits / 2 bytes, see note 2 ...
+        PackPlan plan;
+        make_pack_plan(bits, endian, plan);
+        const std::size_t groups = pack_groups(count, bits, 4);
+        const std::size_t bytes = bits / 2;
+        const __m128i mask = _mm_set1_epi32(static_cast<int>((1u << bits) - 1));
+        const __m128i se = _mm_loadu_si128(reinterpret_cast<const __m128i*>(plan.even));
+        const __m128i so = _mm_loadu_si128(reinterpret_cast<const __m128i*>(plan.odd));
+        // ... no variable per lane shift before AVX2, multiply by 2^shift instead ...
+        const __m128i mul = _mm_setr_epi32(1 << plan.shift[0], 1 << plan.shift[1], 1 << plan.shift[2],
+                                           1 << plan.shift[3]);
+        for (std::size_t g = 0; g < groups; g++) {
+            __m128i v;
+            if (src16) {
+                v = _mm_cvtepi16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src16 + 4 * g)));
+            } else {
+                v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src32 + 4 * g));
+            }
+            v = _mm_mullo_epi32(_mm_and_si128(v, mask), mul);
+            __m128i out = _mm_or_si128(_mm_shuffle_epi8(v, se), _mm_shuffle_epi8(v, so));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + bytes * g), out);
+        }
+        return groups * 4;
+    }
+
+    return 0;
+}
+
+__attribute__((target("sse4.1")))
+std::size_t reverse_sse41(const uint8_t* src, uint8_t* dst, std::size_t len)
+{
+    const __m128i lut = _mm_setr_epi8(0x0, 0x8, 0x4, 0xC, 0x2, 0xA, 0x6, 0xE, 0x1, 0x9, 0x5, 0xD, 0x3, 0xB, 0x7, 0xF);
+    const __m128i low = _mm_set1_epi8(0x0F);
+    std::size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i lo = _mm_shuffle_epi8(lut, _mm_and_si128(v, low));
+        __m128i hi = _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(v, 4), low));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_or_si128(_mm_slli_epi16(lo, 4), hi));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+std::size_t reverse_avx2(const uint8_t* src, uint8_t* dst, std::size_t len)
+{
+    const __m256i lut = _mm256_setr_epi8(0x0, 0x8, 0x4, 0xC, 0x2, 0xA, 0x6, 0xE, 0x1, 0x9, 0x5, 0xD, 0x3, 0xB, 0x7, 0xF,
+                                         0x0, 0x8, 0x4, 0xC, 0x2, 0xA, 0x6, 0xE, 0x1, 0x9, 0x5, 0xD, 0x3, 0xB, 0x7, 0xF);
+    const __m256i low = _mm256_set1_epi8(0x0F);
+    std::size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        __m256i lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(v, low));
+        __m256i hi = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), low));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_or_si256(_mm256_slli_epi16(lo, 4), hi));
+    }
+    return i;
+}
+
+#endif // PERIPHERY_SPI_PACK_X86
+
+#if defined(PERIPHERY_SPI_PACK_NEON)
+
+std::size_t unpack_neon(const uint8_t* src, int32_t* dst32, int16_t* dst16, std::size_t count, unsigned bits,
+                        const UnpackPlan& plan, bool is_signed)
+{
+    const std::size_t groups = unpack_groups(count, bits, plan);
+    const uint8x16_t m0 = vld1q_u8(plan.shuffle);
+    const uint8x16_t m1 = vld1q_u8(plan.shuffle + 16);
+    const int32x4_t s0 = vld1q_s32(plan.shift);
+    const int32x4_t s1 = vld1q_s32(plan.shift + 4);
+    const int32x4_t right = vdupq_n_s32(-static_cast<int32_t>(plan.right));
+
+    for (std::size_t g = 0; g < groups; g++) {
+        const uint8_t* p = src + g * bits;
+        uint32x4_t a = vshlq_u32(vreinterpretq_u32_u8(vqtbl1q_u8(vld1q_u8(p), m0)), s0);
+        uint32x4_t b = vshlq_u32(vreinterpretq_u32_u8(vqtbl1q_u8(vld1q_u8(p + plan.half), m1)), s1);
+        int32x4_t ra, rb;
+        if (is_signed) {
+            ra = vshlq_s32(vreinterpretq_s32_u32(a), right);
+            rb = vshlq_s32(vreinterpretq_s32_u32(b), right);
+        } else {
+            ra = vreinterpretq_s32_u32(vshlq_u32(a, right));
+            rb = vreinterpretq_s32_u32(vshlq_u32(b, right));
+        }
+        if (dst16) {
+            vst1q_s16(dst16 + 8 * g, vcombine_s16(vmovn_s32(ra), vmovn_s32(rb)));
+        } else {
+            vst1q_s32(dst32 + 8 * g, ra);
+            vst1q_s32(dst32 + 8 * g + 4, rb);
+        }
+    }
+    return groups * 8;
+}
+
+std::size_t pack_neon(const int32_t* src32, const int16_t* src16, uint8_t* dst, std::size_t count, unsigned bits,
+                      WordEndian endian)
+{
+    const bool big = endian == WordEndian::Big;
+    static const uint8_t shuffle12[4][16] = {
+        { 2, 1, 0, 10, 9, 8, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255 },
+        { 255, 255, 255, 255, 255, 255, 2, 1, 0, 10, 9, 8, 255, 255, 255, 255 },
+        { 0, 1, 2, 8, 9, 10, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255 },
+        { 255, 255, 255, 255, 255, 255, 0, 1, 2, 8, 9, 10, 255, 255, 255, 255 },
+    };
+    static const uint8_t shuffle24[2][16] = {
+        { 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, 255, 255, 255, 255 },
+        { 0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, 255, 255, 255, 255 },
+    };
+
+    if (bits == 12) {
+        const std::size_t groups = pack_groups(count, 12, 8);
+        const uint32x4_t mask = vdupq_n_u32(0xFFF);
+        const uint8x16_t sa = vld1q_u8(shuffle12[big ? 0 : 2]);
+        const uint8x16_t sb = vld1q_u8(shuffle12[big ? 1 : 3]);
+        for (std::size_t g = 0; g < groups; g++) {
+            uint32x4_t a, b;
+            if (src16) {
+                int16x8_t v = vld1q_s16(src16 + 8 * g);
+                a = vreinterpretq_u32_s32(vmovl_s16(vget_low_s16(v)));
+                b = vreinterpretq_u32_s32(vmovl_s16(vget_high_s16(v)));
+            } else {
+                a = vreinterpretq_u32_s32(vld1q_s32(src32 + 8 * g));
+                b = vreinterpretq_u32_s32(vld1q_s32(src32 + 8 * g + 4));
+            }
+            uint64x2_t a64 = vreinterpretq_u64_u32(vandq_u32(a, mask));
+            uint64x2_t b64 = vreinterpretq_u64_u32(vandq_u32(b, mask));
+            if (big) {
+                a64 = vorrq_u64(vshlq_n_u64(a64, 12), vshrq_n_u64(a64, 32));
+                b64 = vorrq_u64(vshlq_n_u64(b64, 12), vshrq_n_u64(b64, 32));
+            } else {
+                a64 = vorrq_u64(a64, vshrq_n_u64(a64, 20));
+                b64 = vorrq_u64(b64, vshrq_n_u64(b64, 20));
+            }
+            uint8x16_t out = vorrq_u8(vqtbl1q_u8(vreinterpretq_u8_u64(a64), sa),
+                                      vqtbl1q_u8(vreinterpretq_u8_u64(b64), sb));
+            vst1q_u8(dst + 12 * g, out);
+        }
+        return groups * 8;
+    }
+
+    if (bits == 24 && src32) {
+        const std::size_t groups = pack_groups(count, 24, 4);
+        const uint8x16_t s = vld1q_u8(shuffle24[big ? 0 : 1]);
+        for (std::size_t g = 0; g < groups; g++) {
+            uint8x16_t v = vreinterpretq_u8_s32(vld1q_s32(src32 + 4 * g));
+            vst1q_u8(dst + 12 * g, vqtbl1q_u8(v, s));
+        }
+        return groups * 4;
+    }
+
+    if (pack_plan_fits(bits)) {
+        PackPlan plan;
+        make_pack_plan(bits, endian, plan);
+        const std::size_t groups = pack_groups(count, bits, 4);
+        const std::size_t bytes = bits / 2;
+        const uint32x4_t mask = vdupq_n_u32((1u << bits) - 1);
+        const uint8x16_t se = vld1q_u8(plan.even);
+        const uint8x16_t so = vld1q_u8(plan.odd);
+        const int32x4_t shift = vld1q_s32(plan.shift);
+        for (std::size_t g = 0; g < groups; g++) {
+            uint32x4_t v;
+            if (src16) {
+                v = vreinterpretq_u32_s32(vmovl_s16(vld1_s16(src16 + 4 * g)));
+            } else {
+                v = vreinterpretq_u32_s32(vld1q_s32(src32 + 4 * g));
+            }
+            uint8x16_t w = vreinterpretq_u8_u32(vshlq_u32(vandq_u32(v, mask), shift));
+            vst1q_u8(dst + bytes * g, vorrq_u8(vqtbl1q_u8(w, se), vqtbl1q_u8(w, so)));
+        }
+        return groups * 4;
+    }
+
+    return 0;
+}
+
+std::size_t reverse_neon(const uint8_t* src, uint8_t* dst, std::size_t len)
+{
+    std::size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        vst1q_u8(dst + i, vrbitq_u8(vld1q_u8(src + i)));
+    }
+    return i;
+}
+
+#endif // PERIPHERY_SPI_PACK_NEON
+
+// ... runtime dispatch ...
+
+SpiPackIsa detect_isa()
+{
+#if defined(PERIPHERY_SPI_PACK_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return SpiPackIsa::Avx2;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        return SpiPackIsa::Sse41;
+    }
+#elif defined(PERIPHERY_SPI_PACK_NEON)
+    return SpiPackIsa::Neon;
+#endif
+    return SpiPackIsa::Scalar;
+}
+
+SpiPackIsa& selected_isa()
+{
+    static SpiPackIsa isa = detect_isa();
+    return isa;
+}
+
+template <typename T>
+void unpack(const uint8_t* src, T* dst, int32_t* dst32, int16_t* dst16, std::size_t count, unsigned bits,
+            WordEndian endian, bool is_signed)
+{
+    std::size_t done = 0;
+    if (bits <= 25 && count >= 8) {
+        UnpackPlan plan;
+        make_plan(bits, endian, plan);
+        switch (selected_isa()) {
+#if defined(PERIPHERY_SPI_PACK_X86)
+            case SpiPackIsa::Avx2:  done = unpack_avx2(src, dst32, dst16, count, bits, plan, is_signed); break;
+            case SpiPackIsa::Sse41: done = unpack_sse41(src, dst32, dst16, count, bits, plan, is_signed); break;
+#elif defined(PERIPHERY_SPI_PACK_NEON)
+            case SpiPackIsa::Neon:  done = unpack_neon(src, dst32, dst16, count, bits, plan, is_signed); break;
+#endif
+            default: break;
+        }
+        (void)dst32;
+        (void)dst16;
+    }
+    // ... done is a multiple of 8 words, the rest starts on a byte ...
+    unpack_scalar(src + done * bits / 8, dst + done, count - done, bits, endian, is_signed);
+}
+
+template <typename T>
+void pack(const T* src, const int32_t* src32, const int16_t* src16, uint8_t* dst, std::size_t count, unsigned bits,
+          WordEndian endian)
+{
+    std::size_t done = 0;
+    if (bits == 12 || bits == 24 || pack_plan_fits(bits)) {
+        switch (selected_isa()) {
+#if defined(PERIPHERY_SPI_PACK_X86)
+            case SpiPackIsa::Avx2:
+            case SpiPackIsa::Sse41: done = pack_sse41(src32, src16, dst, count, bits, endian); break;
+#elif defined(PERIPHERY_SPI_PACK_NEON)
+            case SpiPackIsa::Neon:  done = pack_neon(src32, src16, dst, count, bits, endian); break;
+#endif
+            default: break;
+        }
+        (void)src32;
+        (void)src16;
+    }
+    // ... done is a whole number of groups, the rest starts on a byte ...
+    pack_scalar(src + done, dst + done * bits / 8, count - done, bits, endian);
+}
+
+void check_bits(unsigned bits, unsigned max)
+{
+    if (bits == 0 || bits > max) {
+        throw std::invalid_argument("SPI word size out of range for the sample type");
+    }
+}
+
+} // ... anonymous namespace ...
+
+
+void spi_unpack(const uint8_t* src, int16_t* dst, std::size_t count, unsigned bits, WordEndian endian, bool is_signed)
+{
+    check_bits(bits, 16);
+    unpack(src, dst, nullptr, dst, count, bits, endian, is_signed);
+}
+
+
+void spi_unpack(const uint8_t* src, int32_t* dst, std::size_t count, unsigned bits, WordEndian endian, bool is_signed)
+{
+    check_bits(bits, 32);
+    unpack(src, dst, dst, nullptr, count, bits, endian, is_signed);
+}
+
+
+void spi_pack(const int16_t* src, uint8_t* dst, std::size_t count, unsigned bits, WordEndian endian)
+{
+    check_bits(bits, 16);
+    pack(src, nullptr, src, dst, count, bits, endian);
+}
+
+
+void spi_pack(const int32_t* src, uint8_t* dst, std::size_t count, unsigned bits, WordEndian endian)
+{
+    check_bits(bits, 32);
+    pack(src, src, nullptr, dst, count, bits, endian);
+}
+
+
+void spi_reverse_bits(uint8_t* data, std::size_t len)
+{
+    spi_reverse_bits(data, data, len);
+}
+
+
+void spi_reverse_bits(const uint8_t* src, uint8_t* dst, std::size_t len)
+{
+    std::size_t done = 0;
+    switch (selected_isa()) {
+#if defined(PERIPHERY_SPI_PACK_X86)
+        case SpiPackIsa::Avx2:  done = reverse_avx2(src, dst, len); break;
+        case SpiPackIsa::Sse41: done = reverse_sse41(src, dst, len); break;
+#elif defined(PERIPHERY_SPI_PACK_NEON)
+        case SpiPackIsa::Neon:  done = reverse_neon(src, dst, len); break;
+#endif
+        default: break;
+    }
+    reverse_scalar(src + done, dst + done, len - done);
+}
+
+
+SpiPackIsa spi_pack_isa()
+{
+    return selected_isa();
+}
+
+
+SpiPackIsa spi_pack_isa(SpiPackIsa isa)
+{
+    SpiPackIsa best = detect_isa();
+    bool supported = isa == SpiPackIsa::Scalar || isa == best
+                     || (isa == SpiPackIsa::Sse41 && best == SpiPackIsa::Avx2);
+    selected_isa() = supported ? isa : best;
+    return selected_isa();
+}
+
+
+} // ... namespace periphery ...
@@ -0,0 +1,165 @@
+/*
+ * cpp-periphery
+ * https://github.com/mpb27/cpp-periphery
+ * License: MIT
+ */
+
+// C++11 includes:
+#include <cerrno>
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+#include <system_error>
+
+// POSIX 2008 Headers:
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "periphery/uio.hpp"
+
+namespace periphery {
+
+namespace {
+
+    std::string sysfs_dir(unsigned device) {
+        return "/sys/class/uio/uio" + std::to_string(device);
+    }
+
+    bool read_line(const std::string& path, std::string& line) {
+        std::ifstream file(path);
+        return static_cast<bool>(std::getline(file, line));
+    }
+
+} // ... anonymous namespace ...
+
+
+Uio::Uio(unsigned device, Mmio::MapOptions options)
+    : m_device(device), m_fd(-1), m_count(0), m_missed(0)
+{
+    const std::string dir = sysfs_dir(device);
+    if (!read_line(dir + "/name", m_name)) {
+        throw std::invalid_argument("no uio" + std::to_string(device));
+    }
+
+    // ... open first, read() reports events counted after open(), so the seed read from sysfs
+    //     afterwards never misses one (read() of the device would block) ...
+    const std::string path = "/dev/uio" + std::to_string(device);
+    m_fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC);
+    if (m_fd < 0) {
+        throw std::system_error(errno, std::system_category(), path);
+    }
+    std::string event;
+    if (read_line(dir + "/event", event)) {
+        m_count = static_cast<uint32_t>(std::strtoul(event.c_str(), nullptr, 0));
+    }
+
+    // ... maps are numbered without holes ...
+    try {
+        struct stat st;
+        for (unsigned i = 0; stat((dir + "/maps/map" + std::to_string(i)).c_str(), &st) == 0; i++) {
+            m_maps.emplace_back(new Mmio(Mmio::uio_region(device, i), options));
+        }
+    } catch (...) {
+        ::close(m_fd);
+        throw;
+    }
+}
+
+Uio::~Uio()
+{
+    if (::close(m_fd) < 0) {
+        // ... never throw from destructor ...
+    }
+}
+
+unsigned Uio::find(const std::string& name)
+{
+    // ... uio numbers are allocated lowest first, stop after a run of missing ones ...
+    struct stat st;
+    for (unsigned i = 0, misses = 0; misses < 16; i++) {
+        std::string line;
+        if (read_line(sysfs_dir(i) + "/name", line)) {
+            if (line == name) {
+                return i;
+            }
+            misses = 0;
+        } else if (stat(sysfs_dir(i).c_str(), &st) != 0) {
+            misses++;
+        }
+    }
+    throw std::invalid_argument("no uio named " + name);
+}
+
+const Mmio& Uio::map(std::size_t index) const
+{
+    if (index >= m_maps.size()) {
+        throw std::out_of_range("uio map index");
+    }
+    return *m_maps[index];
+}
+
+void Uio::irq_control(int32_t value) const
+{
+    if (::write(m_fd, &value, sizeof(value)) != static_cast<ssize_t>(sizeof(value))) {
+        throw std::system_error(errno, std::system_category(), "uio irqcontrol");
+    }
+}
+
+void Uio::enable_irq() const
+{
+    irq_control(1);
+}
+
+void Uio::disable_irq() const
+{
+    irq_control(0);
+}
+
+uint32_t Uio::consume()
+{
+    uint32_t total;
+    ssize_t ret;
+    do {
+        ret = ::read(m_fd, &total, sizeof(total));
+    } while (ret < 0 && errno == EINTR);
+    if (ret != static_cast<ssize_t>(sizeof(total))) {
+        throw std::system_error(ret < 0 ? errno : EIO, std::system_category(), "uio read");
+    }
+
+    // ... the counter wraps, unsigned difference handles it. read() only returns once the count
+    //     moved since open(), no difference means the interrupt came between open() and seeding ...
+    uint32_t events = total - m_count;
+    if (events == 0) {
+        events = 1;
+    }
+    m_count = total;
+    if (events > 1) {
+        m_missed += events - 1;
+    }
+    return events;
+}
+
+uint32_t Uio::wait()
+{
+    return consume();
+}
+
+uint32_t Uio::wait(std::chrono::milliseconds timeout)
+{
+    struct pollfd fds[1];
+    fds[0].fd = m_fd;
+    fds[0].events = POLLIN;
+
+    int ret;
+    do {
+        ret = ::poll(fds, 1, static_cast<int>(timeout.count()));
+    } while (ret < 0 && errno == EINTR);
+    if (ret < 0) {
+        throw std::system_error(errno, std::system_category(), "uio poll");
+    }
+    return ret == 0 ? 0 : consume();
+}
+
+} // ... namespace periphery ...
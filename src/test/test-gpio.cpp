@@ -0,0 +1,51 @@
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <memory>
+
+#include "periphery/gpio.hpp"
+#include "periphery/gpio_mmio.hpp"
+
+int main()
+{
+    using namespace periphery;
+
+    auto chip = std::make_shared<GpioChip>("/dev/gpiochip0");
+
+    // ... 8 bit parallel bus on lines 0..7, one fd for all of them ...
+    GpioLines bus(chip, {0, 1, 2, 3, 4, 5, 6, 7}, "test-gpio", GpioLines::LineConfig(GpioPin::Direction::Low));
+
+    bus.set_values(0xFF, 0xA5);
+    bus.set_values(0x0F, 0x00);
+
+    std::cout << "bus = " << std::hex << bus.get_values() << std::dec << std::endl;
+
+    // ... encoder input on line 8, events drained in batches ...
+    GpioPin encoder(chip, 8, "test-gpio", GpioPin::Direction::In, GpioPin::Edge::Both,
+                    GpioPin::Bias::Default, GpioPin::Drive::Default, GpioPin::Invert::Off,
+                    GpioPin::EventClock::Monotonic, 256);
+
+    std::array<GpioPin::Event, 64> events;
+    if (encoder.wait_events(std::chrono::milliseconds(100))) {
+        auto n = encoder.read_events(events);
+        for (std::size_t i = 0; i < n; ++i) {
+            std::cout << events[i].timestamp_ns << " "
+                      << (events[i].edge() == GpioPin::Edge::Rising ? "rising" : "falling") << "\n";
+        }
+    }
+    std::cout << "dropped = " << encoder.dropped_events() << std::endl;
+
+    // ... bit-banged clock on line 9 through the bank registers (AM335x GPIO0 layout) ...
+    auto bank = std::make_shared<Mmio>(0x44E07000, 0x1000);
+    GpioBankLayout am335x = { 0x138, 0x134, 0x194, 0x190, 32, false };
+    GpioMmioPin clk(chip, 9, "test-gpio", bank, am335x, 9, GpioPin::Direction::Low);
+
+    for (int i = 0; i < 1000; ++i) {
+        clk.set(GpioPin::State::High);
+        clk.set(GpioPin::State::Low);
+    }
+}
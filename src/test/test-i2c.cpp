@@ -1,6 +1,9 @@
+#include <array>
 #include <iostream>
+#include <memory>
 
 #include "periphery/i2c.hpp"
+#include "periphery/i2c_scheduler.hpp"
 
 int main()
 {
@@ -16,4 +19,38 @@ int main()
     uint8_t y = readByte.data[0];
 
     std::cout << "EEPROM(100h) = " << y << std::endl;
+
+    // ... same read without allocating, buffers and messages live on the stack ...
+    std::array<uint8_t, 2> reg = {{0x01, 0x00}};
+    std::array<uint8_t, 16> page;
+
+    I2C::Transaction<2> t;
+    t.write(0x56, buffer(reg)).read(0x56, buffer(page));
+    i2c.transfer(t);
+
+    i2c.transfer(0x56, { I2C::BufferMessage::write(buffer(reg)), I2C::BufferMessage::read(buffer(page)) });
+
+    // ... temperature sensor registers, SMBus when the adapter supports it ...
+    auto config = i2c.read_reg8(0x48, 0x01);
+    i2c.write_reg8(0x48, 0x01, config | 0x60);
+    auto temp = i2c.read_reg16(0x48, 0x00, I2C::ByteOrder::BigEndian);
+
+    std::cout << "TEMP = " << (temp >> 4) << std::endl;
+
+    // ... shared bus, both devices end up in one I2C_RDWR when queued together ...
+    I2CScheduler bus(std::make_shared<I2C>("/dev/i2c-0"));
+
+    std::array<uint8_t, 1> temp_reg = {{0x00}};
+    std::array<uint8_t, 2> temp_raw;
+    I2C::Transaction<2> sensor;
+    sensor.write(0x48, buffer(temp_reg)).read(0x48, buffer(temp_raw));
+
+    auto f1 = bus.submit(I2CScheduler::Priority::High, sensor);
+    auto f2 = bus.submit(I2CScheduler::Priority::Low, t);
+    f1.get();
+    f2.get();
+
+    auto stats = bus.latency(I2CScheduler::Priority::High);
+    std::cout << "batches = " << bus.batches() << ", transactions = " << bus.transactions()
+              << ", high queue max = " << stats.queue_max.count() << " ns" << std::endl;
 }
@@ -1,4 +1,20 @@
+#include <iostream>
+
 #include "periphery/mmio.hpp"
+#include "periphery/mmio_batch.hpp"
+#include "periphery/mmio_register.hpp"
+
+using namespace periphery;
+
+// ... register map of a hypothetical peripheral ...
+struct Regs {
+    using CTRL   = MmioRegister<0x00, uint32_t>;
+    using STATUS = MmioRegister<0x04, uint32_t, MmioAccess::ReadOnly>;
+    using ID     = MmioRegister<0x08, uint32_t, MmioAccess::ReadOnly, MmioEndian::Big>;
+    using ENABLE = MmioField<CTRL, 0, 1>;
+    using MODE   = MmioField<CTRL, 4, 3>;
+    using READY  = MmioField<STATUS, 31, 1>;
+};
 
 int main()
 {
@@ -8,4 +24,47 @@ int main()
 
     mmio.read(0, tmp, 256);
     mmio.write(0x100, tmp, 256);
+
+    uint32_t words[16];
+    mmio.read_burst32(0, words, 16);
+    mmio.write_burst32(0x100, words, 16);
+    mmio.read_fifo32(0x40, words, 16);
+
+    // ... same pages, shares the mapping of mmio, now locked ...
+    periphery::Mmio window(0x200, 0x40, periphery::Mmio::MapOptions{ true, true, false });
+    (void)window.read32(0);
+
+    MmioBlock<0x100> regs(mmio);
+    regs.write(Regs::ENABLE::of(1), Regs::MODE::of(5));
+    regs.modify(Regs::MODE::of(2));
+    (void)regs.get<Regs::READY>();
+    (void)regs.read<Regs::ID>();
+
+    // ... init sequence recorded once, replayed on two instances of the block ...
+    MmioBatch init;
+    init.write32(0x08, 0)
+        .set32(0x00, 0x10)
+        .clear32(0x00, 0x01)        // ... merged with the set32 above ...
+        .barrier()
+        .set32(0x00, 0x01)
+        .read_back(0x00);
+    init.apply(mmio, 0x000);
+    init.apply(mmio, 0x100);
+
+    // ... reset pulse, both stores must reach the device, plain writes are never merged ...
+    MmioBatch pulse;
+    pulse.write32(0x0C, 1)
+         .write32(0x0C, 0);
+    pulse.apply(mmio);
+    std::cout << "pulse: " << pulse.recorded() << " recorded, " << pulse.size()
+              << (pulse.size() == 2 ? " applied, ok" : " applied, MERGED") << std::endl;
+
+    // ... read to clear status between two modifies, the second one must not move before it ...
+    MmioBatch ack;
+    ack.set32(0x00, 0x02)
+       .read_back(0x04)
+       .clear32(0x00, 0x02);
+    ack.apply(mmio);
+    std::cout << "ack: " << ack.recorded() << " recorded, " << ack.size()
+              << (ack.size() == 3 ? " applied, ok" : " applied, REORDERED") << std::endl;
 }
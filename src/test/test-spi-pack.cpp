@@ -0,0 +1,97 @@
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "periphery/spi_pack.hpp"
+
+using namespace periphery;
+
+// ... SIMD against scalar for every word size, both word orders, both sample types and counts
+//     around the group sizes, needs no hardware. Run it on every new target before enabling its
+//     SIMD code (PERIPHERY_NEON on aarch64) ...
+
+template <typename T>
+static bool check(unsigned bits, WordEndian endian, std::size_t count, SpiPackIsa simd, std::mt19937& rng)
+{
+    std::vector<T> words(count);
+    for (auto& w : words) {
+        w = static_cast<T>(rng());
+    }
+    std::vector<uint8_t> packed[2], stream(spi_packed_size(count, bits));
+    for (auto& b : stream) {
+        b = static_cast<uint8_t>(rng());
+    }
+    std::vector<T> unpacked[2][2];
+
+    const SpiPackIsa isas[2] = { SpiPackIsa::Scalar, simd };
+    for (int i = 0; i < 2; i++) {
+        spi_pack_isa(isas[i]);
+        packed[i].assign(stream.size(), 0);
+        spi_pack(words.data(), packed[i].data(), count, bits, endian);
+        for (int s = 0; s < 2; s++) {
+            unpacked[i][s].assign(count, 0);
+            spi_unpack(stream.data(), unpacked[i][s].data(), count, bits, endian, s == 1);
+        }
+    }
+
+    // ... and a round trip, unpacking what was packed gives the low bits back ...
+    std::vector<T> back(count);
+    spi_unpack(packed[1].data(), back.data(), count, bits, endian, false);
+    const uint32_t mask = bits >= 32 ? 0xFFFFFFFFu : (1u << bits) - 1;
+    bool round_trip = true;
+    for (std::size_t i = 0; i < count; i++) {
+        if ((static_cast<uint32_t>(back[i]) & mask) != (static_cast<uint32_t>(words[i]) & mask)) {
+            round_trip = false;
+        }
+    }
+
+    bool ok = packed[0] == packed[1] && unpacked[0][0] == unpacked[1][0] && unpacked[0][1] == unpacked[1][1]
+              && round_trip;
+    if (!ok) {
+        std::cout << "MISMATCH " << (sizeof(T) == 2 ? "int16 " : "int32 ") << bits << " bit "
+                  << (endian == WordEndian::Big ? "BE" : "LE") << " count " << count << std::endl;
+    }
+    return ok;
+}
+
+int main()
+{
+    const SpiPackIsa simd = spi_pack_isa();
+    if (simd == SpiPackIsa::Scalar) {
+        std::cout << "no SIMD implementation in use, nothing to compare" << std::endl;
+        return EXIT_SUCCESS;
+    }
+
+    std::mt19937 rng(1);
+    bool ok = true;
+    std::size_t cases = 0;
+    const std::size_t counts[] = { 0, 1, 3, 4, 7, 8, 9, 15, 16, 17, 31, 33, 64, 100, 257, 4099 };
+    const WordEndian endians[] = { WordEndian::Big, WordEndian::Little };
+    for (unsigned bits = 1; bits <= 32; bits++) {
+        for (auto endian : endians) {
+            for (auto count : counts) {
+                if (bits <= 16) {
+                    ok = check<int16_t>(bits, endian, count, simd, rng) && ok;
+                    cases++;
+                }
+                ok = check<int32_t>(bits, endian, count, simd, rng) && ok;
+                cases++;
+            }
+        }
+    }
+
+    std::vector<uint8_t> data(4099), ref(data.size()), out(data.size());
+    for (auto& b : data) {
+        b = static_cast<uint8_t>(rng());
+    }
+    spi_pack_isa(SpiPackIsa::Scalar);
+    spi_reverse_bits(data.data(), ref.data(), data.size());
+    spi_pack_isa(simd);
+    spi_reverse_bits(data.data(), out.data(), data.size());
+    ok = ok && out == ref;
+
+    std::cout << cases << " cases, " << (ok ? "SIMD matches scalar" : "MISMATCH") << std::endl;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
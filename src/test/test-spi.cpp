@@ -2,9 +2,15 @@
 #include <cstdint>
 #include <cstring>
 
+#include <array>
 #include <iostream>
+#include <memory>
+#include <vector>
 
 #include "periphery/spi.hpp"
+#include "periphery/spi_display.hpp"
+#include "periphery/spi_flash.hpp"
+#include "periphery/gpio.hpp"
 
 int main()
 {
@@ -27,4 +33,64 @@ int main()
     uint8_t rx[16];
 
     spi.transfer(tx, rx, 16);
+
+    // ... command then payload with CS held, one ioctl per cycle, the plan is built once ...
+    std::array<uint8_t, 4> cmd = {{0x03, 0x00, 0x00, 0x00}};
+    std::array<uint8_t, 256> payload;
+
+    Spi::Plan<2> plan;
+    plan.write(buffer(cmd)).read(buffer(payload));
+    plan.back().speed(4000000).bits_per_word(8);
+
+    for (int i = 0; i < 4; i++) {
+        cmd[2] = static_cast<uint8_t>(i);
+        spi.transfer(plan);
+    }
+
+    // ... quad output fast read (0x6B), single line command and address, data on 4 lines ...
+    spi.bus_width(Spi::BusWidth::Single, Spi::BusWidth::Quad);
+    if (spi.rx_bus_width() == Spi::BusWidth::Quad) {
+        std::array<uint8_t, 5> fast_read = {{0x6B, 0x00, 0x00, 0x00, 0x00}};
+        spi.transfer({ Spi::Segment::write(buffer(fast_read)),
+                       Spi::Segment::read(buffer(payload)).rx_width(Spi::BusWidth::Quad) });
+    }
+
+    // ... NOR flash, quad I/O reads when both the part and the controller allow it ...
+    auto flash_spi = std::make_shared<Spi>("/dev/spidev0.0", Spi::Mode::Zero, Spi::BitOrder::MsbFirst, 50000000);
+    flash_spi->bus_width(Spi::BusWidth::Quad, Spi::BusWidth::Quad);
+    SpiFlash flash(flash_spi);
+    if (flash.info().quad_io && flash_spi->rx_bus_width() == Spi::BusWidth::Quad) {
+        flash.read_mode(SpiFlash::ReadMode::QuadIO);
+    }
+    std::cout << "flash " << std::hex << static_cast<int>(flash.info().manufacturer) << ":" << flash.info().device
+              << std::dec << ", " << flash.info().size << " bytes" << std::endl;
+
+    std::vector<uint8_t> image(1 << 20);
+    flash.read(0, buffer(image));
+    flash.erase(0, 4096);
+    flash.program(0, buffer(image.data(), 4096));
+
+    // ... 320x240 panel, D/C on gpiochip0 line 25, only the moving box is sent each frame ...
+    auto panel_spi = std::make_shared<Spi>("/dev/spidev0.1", Spi::Mode::Zero, Spi::BitOrder::MsbFirst, 40000000);
+    auto chip = std::make_shared<GpioChip>("/dev/gpiochip0");
+    auto dc = std::make_shared<GpioPin>(chip, 25, "lcd-dc", GpioPin::Direction::High);
+    SpiDisplay display(panel_spi, dc, 320, 240);
+
+    display.invalidate();
+    display.present();
+    for (uint16_t x = 0; x < 300; x += 4) {
+        uint8_t* fb = display.framebuffer();
+        for (uint16_t y = 100; y < 120; y++) {
+            for (uint16_t i = 0; i < 24; i++) {
+                uint8_t* p = fb + y * display.stride() + (x + i) * 3;
+                p[0] = i < 4 ? 0 : 0xFF;
+                p[1] = 0;
+                p[2] = 0;
+            }
+        }
+        display.mark_dirty(SpiDisplay::Rect{ x, 100, 24, 20 });
+        display.present();
+    }
+    display.wait_idle();
+    std::cout << display.frames() << " frames, " << display.pixel_bytes() << " pixel bytes" << std::endl;
 }
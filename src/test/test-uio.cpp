@@ -0,0 +1,26 @@
+#include <chrono>
+#include <iostream>
+
+#include "periphery/uio.hpp"
+
+int main(int argc, char* argv[])
+{
+    using namespace periphery;
+
+    Uio uio(argc > 1 ? Uio::find(argv[1]) : 0);
+
+    std::cout << "uio" << uio.device() << " " << uio.name() << ", " << uio.maps() << " maps" << std::endl;
+    for (std::size_t i = 0; i < uio.maps(); i++) {
+        std::cout << "  map" << i << " " << uio.map(i).size() << " bytes, first word 0x"
+                  << std::hex << uio.map(i).read32(0) << std::dec << std::endl;
+    }
+
+    // ... count interrupts for a second ...
+    uint32_t events = 0;
+    auto end = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (std::chrono::steady_clock::now() < end) {
+        uio.enable_irq();
+        events += uio.wait(std::chrono::milliseconds(100));
+    }
+    std::cout << events << " interrupts, " << uio.missed() << " missed" << std::endl;
+}
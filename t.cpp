@@ -0,0 +1,56 @@
+// ... a window costs about as much as this many pixels on the wire (3 D/C switches, 6 messages) ...
+static constexpr uint32_t window_cost = 256;
+
+static uint32_t area(const SpiDisplay::Rect& r)
+{
+    return static_cast<uint32_t>(r.w) * r.h;
+}
+
+static SpiDisplay::Rect bounding(const SpiDisplay::Rect& a, const SpiDisplay::Rect& b)
+{
+    uint16_t x0 = std::min(a.x, b.x);
+    uint16_t y0 = std::min(a.y, b.y);
+    uint16_t x1 = static_cast<uint16_t>(std::max(a.x + a.w, b.x + b.w));
+    uint16_t y1 = static_cast<uint16_t>(std::max(a.y + a.h, b.y + b.h));
+    return SpiDisplay::Rect{ x0, y0, static_cast<uint16_t>(x1 - x0), static_cast<uint16_t>(y1 - y0) };
+}
+
+// ... merge while sending the bounding box is cheaper than two windows, then down to max_windows ...
+static void merge_rects(std::vector<SpiDisplay::Rect>& rects)
+{
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        for (std::size_t i = 0; i < rects.size() && !merged; i++) {
+            for (std::size_t j = i + 1; j < rects.size(); j++) {
+                auto u = bounding(rects[i], rects[j]);
+                if (area(u) <= area(rects[i]) + area(rects[j]) + window_cost) {
+                    rects[i] = u;
+                    rects.erase(rects.begin() + static_cast<std::ptrdiff_t>(j));
+                    merged = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    while (rects.size() > SpiDisplay::max_windows) {
+        std::size_t bi = 0, bj = 1;
+        int64_t best = INT64_MAX;
+        for (std::size_t i = 0; i < rects.size(); i++) {
+            for (std::size_t j = i + 1; j < rects.size(); j++) {
+                int64_t growth = static_cast<int64_t>(area(bounding(rects[i], rects[j])))
+                               - area(rects[i]) - area(rects[j]);
+                if (growth < best) {
+                    best = growth;
+                    bi = i;
+                    bj = j;
+                }
+            }
+        }
+        rects[bi] = bounding(rects[bi], rects[bj]);
+        rects.erase(rects.begin() + static_cast<std::ptrdiff_t>(bj));
+    }
+}
+int main(){ std::vector<SpiDisplay::Rect> r={{0,0,128,240},{0,0,320,96},{192,0,128,240}};
+ merge_rects(r); uint32_t t=0; for(auto&x:r) t+=area(x); printf("rects=%zu total_px=%u buffer_px=%u\n", r.size(), t, 320*240); }